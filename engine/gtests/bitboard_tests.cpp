@@ -0,0 +1,37 @@
+//
+// Created by paul on 10/16/26.
+//
+
+#include <ChePP/engine/bitboard.h>
+#include <gtest/gtest.h>
+
+// the tables against plain ray walking, for every blocker subset of every square and with noise outside the masks
+template <PieceType pc>
+void expect_slider_attacks()
+{
+    uint64_t noise = 0x9E3779B97F4A7C15ULL;
+    for (auto sq = A1; sq <= H8; ++sq)
+    {
+        const Bitboard mask     = relevancy_mask<pc>(sq);
+        Bitboard       blockers = bb::empty();
+        do
+        {
+            noise ^= noise << 13;
+            noise ^= noise >> 7;
+            noise ^= noise << 17;
+            const Bitboard occupancy = blockers | (Bitboard{noise} & ~mask);
+            ASSERT_EQ(attacks<pc>(sq, occupancy), ray<pc>(sq, occupancy)) << sq << "\n" << occupancy;
+            blockers = Bitboard{(blockers.value() - mask.value()) & mask.value()};
+        } while (blockers);
+    }
+}
+
+TEST(Bitboard, BishopAttacksMatchRays)
+{
+    expect_slider_attacks<BISHOP>();
+}
+
+TEST(Bitboard, RookAttacksMatchRays)
+{
+    expect_slider_attacks<ROOK>();
+}
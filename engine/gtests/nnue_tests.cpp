@@ -0,0 +1,257 @@
+//
+// Created by paul on 10/16/26.
+//
+
+#include <ChePP/engine/movegen.h>
+#include <ChePP/engine/nnue.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <hwy/targets.h>
+#include <vector>
+
+// the lazy stack must end up with exactly what a full refresh of the same position gives
+TEST(NNUE, LazyAccumulatorsMatchRefresh)
+{
+    Positions    positions("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    Accumulators accumulators(positions.last());
+
+    // quiet, capture, castling and king moves, evaluated only at some plies
+    const std::array moves = {
+        Move::make<NORMAL>(D5, E6), Move::make<NORMAL>(E8, F8), Move::make<CASTLING>(E1, G1, WHITE_KINGSIDE),
+        Move::make<NORMAL>(F6, E4), Move::make<NORMAL>(E6, F7), Move::make<NORMAL>(E7, F7),
+    };
+    for (size_t i = 0; i < moves.size(); ++i)
+    {
+        positions.do_move(moves[i]);
+        accumulators.do_move(positions[positions.ply() - 1], positions.last());
+        if (i % 2 == 0 && i != 0)
+            continue;
+
+        const Position&   pos = positions.last();
+        const Accumulator fresh{pos};
+        for (const auto view : {WHITE, BLACK})
+        {
+            EXPECT_EQ(accumulators.last().evaluate(view), fresh.evaluate(view)) << "ply " << i << "\n" << pos;
+        }
+    }
+
+    // going back down does not need anything recomputed
+    while (positions.ply() > 2)
+    {
+        positions.undo_move();
+        accumulators.undo_move();
+    }
+    const Accumulator fresh{positions.last()};
+    EXPECT_EQ(accumulators.last().evaluate(WHITE), fresh.evaluate(WHITE));
+}
+
+// king walks in and out of buckets, so refreshes hit both cold and already used cache entries
+TEST(NNUE, FinnyTableMatchesRefresh)
+{
+    Positions    positions("8/5k2/8/2p5/8/3P4/1K6/8 w - - 0 1");
+    Accumulators accumulators(positions.last());
+
+    const std::array moves = {
+        Move::make<NORMAL>(B2, C3), Move::make<NORMAL>(F7, E6), Move::make<NORMAL>(C3, C4),
+        Move::make<NORMAL>(E6, D6), Move::make<NORMAL>(C4, B5), Move::make<NORMAL>(D6, E5),
+        Move::make<NORMAL>(B5, C4), Move::make<NORMAL>(E5, E6), Move::make<NORMAL>(C4, C5),
+        Move::make<NORMAL>(E6, F7), Move::make<NORMAL>(C5, D5), Move::make<NORMAL>(F7, G7),
+    };
+    for (const auto move : moves)
+    {
+        positions.do_move(move);
+        accumulators.do_move(positions[positions.ply() - 1], positions.last());
+
+        const Accumulator fresh{positions.last()};
+        EXPECT_EQ(accumulators.last().evaluate(WHITE), fresh.evaluate(WHITE)) << positions.last();
+        EXPECT_EQ(accumulators.last().evaluate(BLACK), fresh.evaluate(BLACK)) << positions.last();
+    }
+}
+
+namespace
+{
+// the embedded net written back out, optionally behind a header
+void write_net(const std::string& path, const bool header, const uint64_t hash_xor = 0)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (header)
+    {
+        net_file_header_t h{};
+        h.m_layers        = Network::N_LAYERS;
+        h.m_payload_bytes = Network::payload_bytes();
+        h.m_payload_hash  = Network::FNV_OFFSET;
+        for (size_t i = 0; i < Network::N_LAYERS; ++i)
+            h.m_payload_hash = Network::fnv1a(h.m_payload_hash, static_cast<const char*>(g_network_layers[i].data),
+                                              Network::layer_bytes(i));
+        h.m_payload_hash ^= hash_xor;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+    for (size_t i = 0; i < Network::N_LAYERS; ++i)
+        out.write(static_cast<const char*>(g_network_layers[i].data),
+                  static_cast<std::streamsize>(Network::layer_bytes(i)));
+}
+} // namespace
+
+TEST(NNUE, LoadsNetFiles)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "chepp_test.net").string();
+    Position   pos;
+    pos.from_fen("r1bq1rk1/ppp2ppp/2np1n2/2b1p3/2B1P3/2NP1N2/PPP2PPP/R1BQ1RK1 w - - 0 7");
+    const int32_t embedded = Accumulator{pos}.evaluate(WHITE);
+
+    write_net(path, false);
+    ASSERT_TRUE(g_net.load(path));
+    EXPECT_EQ(g_net.name(), path);
+    EXPECT_EQ(Accumulator{pos}.evaluate(WHITE), embedded);
+
+    write_net(path, true);
+    ASSERT_TRUE(g_net.load(path));
+    EXPECT_EQ(Accumulator{pos}.evaluate(WHITE), embedded);
+
+    // a failed load keeps whatever net was there
+    write_net(path, true, 1);
+    EXPECT_FALSE(g_net.load(path));
+    EXPECT_EQ(g_net.name(), path);
+
+    std::filesystem::resize_file(path, Network::payload_bytes() - 1);
+    EXPECT_FALSE(g_net.load(path));
+    EXPECT_FALSE(g_net.load(path + ".missing"));
+
+    g_net.use_embedded();
+    EXPECT_EQ(g_net.name(), Network::EMBEDDED);
+    std::filesystem::remove(path);
+}
+
+TEST(NNUE, MapsNetBlobs)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "chepp_test.blob").string();
+    Position   pos;
+    pos.from_fen("r2q1rk1/1b2bppp/p2p1n2/1p2p3/3NP3/1BN5/PPP2PPP/R2QR1K1 w - - 0 12");
+    const int32_t embedded = Accumulator{pos}.evaluate(BLACK);
+
+    ASSERT_TRUE(g_net.save_blob(path));
+    ASSERT_TRUE(g_net.load(path));
+    EXPECT_TRUE(g_net.mapped());
+    EXPECT_EQ(Accumulator{pos}.evaluate(BLACK), embedded);
+
+    // writing over the mapped blob is refused
+    EXPECT_FALSE(g_net.save_blob(path));
+    g_net.use_embedded();
+
+    // a blob from another architecture is refused
+    {
+        std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(offsetof(net_blob_header_t, m_arch));
+        f.put('?');
+    }
+    EXPECT_FALSE(g_net.load(path));
+    EXPECT_EQ(g_net.name(), Network::EMBEDDED);
+    std::filesystem::remove(path);
+}
+
+// every instruction set the kernels are dispatched to must give bit exact results
+TEST(NNUE, DispatchedTargetsAgree)
+{
+    Positions positions("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    positions.do_move(Move::make<NORMAL>(D5, E6));
+
+    std::vector<int32_t> evals;
+    for (const int64_t target : hwy::SupportedAndGeneratedTargets())
+    {
+        hwy::SetSupportedTargetsForTest(target);
+        const Accumulator root{positions[positions.ply() - 1]};
+        const Accumulator child{root, positions.last(), positions[positions.ply() - 1]};
+        const Accumulator fresh{positions.last()};
+        EXPECT_EQ(child.evaluate(WHITE), fresh.evaluate(WHITE)) << nnue_kernels::target_name();
+        EXPECT_EQ(child.evaluate(BLACK), fresh.evaluate(BLACK)) << nnue_kernels::target_name();
+        evals.push_back(child.evaluate(BLACK));
+    }
+    hwy::SetSupportedTargetsForTest(0);
+
+    ASSERT_FALSE(evals.empty());
+    for (const int32_t eval : evals)
+        EXPECT_EQ(eval, evals.front());
+}
+
+// the l1 dot products of every target against the scalar layers
+TEST(NNUE, KernelsMatchScalarReference)
+{
+    const std::array fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    };
+    for (const int64_t target : hwy::SupportedAndGeneratedTargets())
+    {
+        hwy::SetSupportedTargetsForTest(target);
+        for (const auto fen : fens)
+        {
+            // the children give many more activation patterns than the roots alone
+            Positions positions(fen);
+            for (const auto [move, score] : gen_legal(positions.last()))
+            {
+                positions.do_move(move);
+                const Accumulator acc{positions.last()};
+                for (const auto view : {WHITE, BLACK})
+                    EXPECT_EQ(acc.evaluate(view), acc.evaluate_reference(view))
+                        << nnue_kernels::target_name() << " " << fen << " " << move;
+                positions.undo_move();
+            }
+            const Accumulator acc{positions.last()};
+            for (const auto view : {WHITE, BLACK})
+                EXPECT_EQ(acc.evaluate(view), acc.evaluate_reference(view))
+                    << nnue_kernels::target_name() << " " << fen;
+        }
+    }
+    hwy::SetSupportedTargetsForTest(0);
+}
+
+// a batch, including a short last one, gives exactly the one at a time and the scalar evaluations on every target
+TEST(NNUE, BatchMatchesSingleEvaluations)
+{
+    const std::array fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/5k2/8/2p5/8/3P4/1K6/8 b - - 0 1",
+        "r1bq1rk1/ppp2ppp/2np1n2/2b1p3/2B1P3/2NP1N2/PPP2PPP/R1BQ1RK1 b - - 0 7",
+        "r2q1rk1/1b2bppp/p2p1n2/1p2p3/3NP3/1BN5/PPP2PPP/R2QR1K1 b - - 0 12",
+        "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1",
+        "6k1/5ppp/8/8/8/8/5PPP/3R2K1 b - - 0 1",
+    };
+    std::vector<Position> positions(fens.size());
+    for (size_t i = 0; i < fens.size(); ++i)
+        positions[i].from_fen(fens[i]);
+
+    for (const int64_t target : hwy::SupportedAndGeneratedTargets())
+    {
+        hwy::SetSupportedTargetsForTest(target);
+        std::vector<int32_t> evals(positions.size());
+        Accumulator::evaluate_batch(positions, evals);
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            const Accumulator acc{positions[i]};
+            const Color       us = positions[i].side_to_move();
+            EXPECT_EQ(evals[i], acc.evaluate(us)) << nnue_kernels::target_name() << " " << fens[i];
+            EXPECT_EQ(evals[i], acc.evaluate_reference(us)) << nnue_kernels::target_name() << " " << fens[i];
+        }
+    }
+    hwy::SetSupportedTargetsForTest(0);
+}
+
+// every piece count maps to a bucket, the buckets never go down as pieces are added, and all of them are used
+TEST(NNUE, OutputBucketsCoverPieceCounts)
+{
+    EXPECT_EQ(output_bucket(2), 0u);
+    EXPECT_EQ(output_bucket(32), N_OUTPUT_BUCKETS - 1);
+    for (int pieces = 3; pieces <= 32; ++pieces)
+    {
+        EXPECT_GE(output_bucket(pieces), output_bucket(pieces - 1));
+        EXPECT_LE(output_bucket(pieces), output_bucket(pieces - 1) + 1);
+    }
+}
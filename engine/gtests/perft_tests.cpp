@@ -2,6 +2,7 @@
 // Created by paul on 7/29/25.
 //
 
+#include <ChePP/engine/move_ordering.h>
 #include <ChePP/engine/movegen.h>
 #include <gtest/gtest.h>
 
@@ -64,6 +65,153 @@ TEST(EngineTest, PerftCases)
             size_t out = 0;
             pft2(pos, d, out);
             EXPECT_EQ(out, test_case.expected_perfts[d]) << "Failed on " << test_case.name << " at depth " << d;
+
+            // pseudo legal generation with the legality check deferred to the moment a move is played
+            size_t deferred = 0;
+            perft(pos.last(), static_cast<int>(d), deferred);
+            EXPECT_EQ(deferred, test_case.expected_perfts[d])
+                << "Deferred legality on " << test_case.name << " at depth " << d;
+        }
+    }
+}
+
+// every pseudo legal move exactly once, whatever tt move and killers it is handed
+// moves of the parent are used for them, so most are not even pseudo legal in the child
+TEST(EngineTest, MovePickerYieldsEveryMoveOnce)
+{
+    const std::array fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "8/3K4/2p5/p2b2r1/5k2/8/8/1q6 b - - 1 67",
+    };
+    const HistoryManager history;
+
+    for (const auto fen : fens)
+    {
+        Positions      positions{fen};
+        const MoveList parent = gen_legal(positions.last());
+        for (size_t i = 0; i < parent.size(); ++i)
+        {
+            positions.do_move(parent[i].move);
+
+            const MoveList  pseudo = gen_moves(positions.last());
+            SearchStackNode ss{};
+            ss.killer1 = parent[(i + 1) % parent.size()].move;
+            ss.killer2 = parent[(i + 2) % parent.size()].move;
+            const Move tt_move = i % 2 || pseudo.empty() ? parent[(i + 3) % parent.size()].move : pseudo.back().move;
+
+            MovePicker        picker(positions.positions(), tt_move, history, ss);
+            std::vector<Move> picked;
+            for (Move m = picker.next(); m != Move::none(); m = picker.next())
+                picked.push_back(m);
+
+            std::vector<Move> expected;
+            for (const auto [m, s] : pseudo)
+                expected.push_back(m);
+            std::ranges::sort(picked, [](const Move a, const Move b) { return a.raw() < b.raw(); });
+            std::ranges::sort(expected, [](const Move a, const Move b) { return a.raw() < b.raw(); });
+            EXPECT_EQ(picked, expected) << positions.last();
+
+            positions.undo_move();
+        }
+    }
+}
+
+namespace
+{
+std::vector<Move> sorted_moves(const MoveList& list)
+{
+    std::vector<Move> moves;
+    for (const auto [m, s] : list)
+        moves.push_back(m);
+    std::ranges::sort(moves, [](const Move a, const Move b) { return a.raw() < b.raw(); });
+    return moves;
+}
+
+void check_gen_types(const Position& pos, const int depth)
+{
+    const MoveList all = gen_moves(pos);
+
+    MoveList split;
+    gen_moves<CAPTURES>(pos, split);
+    gen_moves<QUIETS>(pos, split);
+    EXPECT_EQ(sorted_moves(split), sorted_moves(all)) << pos;
+
+    if (pos.checkers(pos.side_to_move()))
+    {
+        EXPECT_EQ(sorted_moves(gen_moves<EVASIONS>(pos)), sorted_moves(all)) << pos;
+    }
+    else
+    {
+        // the legal quiets that leave the moved piece attacking the enemy king
+        MoveList expected;
+        for (const auto [m, s] : gen_moves<QUIETS>(pos))
+        {
+            if (m.type_of() == CASTLING || !pos.is_legal(m))
+                continue;
+            if (Position{pos, m}.checkers(~pos.side_to_move()).is_set(m.to_sq()))
+                expected.add(m);
+        }
+        MoveList checks = gen_moves<QUIET_CHECKS>(pos);
+        checks.filter([&](const ScoredMove& mv) { return pos.is_legal(mv.move); });
+        EXPECT_EQ(sorted_moves(checks), sorted_moves(expected)) << pos;
+    }
+
+    if (depth == 0)
+        return;
+    for (const auto [m, s] : all)
+    {
+        if (pos.is_legal(m))
+            check_gen_types(Position{pos, m}, depth - 1);
+    }
+}
+} // namespace
+
+// captures and quiets split every move, evasions are every move in check, quiet checks are exactly the direct checks
+TEST(EngineTest, GenerationTypesMatchFullGeneration)
+{
+    const std::array fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "8/3K4/2p5/p2b2r1/5k2/8/8/1q6 b - - 1 67",
+    };
+    for (const auto fen : fens)
+    {
+        Position pos;
+        pos.from_fen(fen);
+        check_gen_types(pos, 2);
+    }
+}
+
+// the threshold form gives the same verdict as the full exchange, for captures and quiet moves alike
+TEST(EngineTest, SeeGeMatchesSee)
+{
+    const std::array fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1",
+        "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1",
+    };
+    for (const auto fen : fens)
+    {
+        Position root;
+        root.from_fen(fen);
+        for (const auto [r, rs] : gen_legal(root))
+        {
+            const Position pos{root, r};
+            for (const auto [m, s] : gen_legal(pos))
+            {
+                if (m.type_of() == CASTLING)
+                    continue;
+                const int see = pos.see(m);
+                for (int threshold = -1000; threshold <= 1000; threshold += 50)
+                    ASSERT_EQ(pos.see_ge(m, threshold), see >= threshold) << pos << m.to_string() << " " << threshold;
+            }
         }
     }
 }
@@ -0,0 +1,230 @@
+//
+// Created by paul on 10/16/26.
+//
+
+#include <ChePP/engine/tt.h>
+#include <filesystem>
+#include <gtest/gtest.h>
+
+// stands for the hash of the net the cached evals come from
+constexpr uint64_t NET_HASH = 0x0123456789abcdefULL;
+
+TEST(TranspositionTable, StoreThenProbe)
+{
+    tt_t tt;
+    ASSERT_TRUE(tt.init(1));
+
+    const hash_t hash = 0x123456789abcdef0ULL;
+    const Move   move = Move::make<NORMAL>(E2, E4);
+    tt.store(hash, 7, -42, LOWER, move, 13);
+
+    const auto hit = tt.probe(hash);
+    ASSERT_TRUE(hit.has_value());
+    EXPECT_EQ(hit->m_depth, 7);
+    EXPECT_EQ(hit->m_score, -42);
+    EXPECT_EQ(hit->m_eval, 13);
+    EXPECT_EQ(hit->m_move, move);
+    EXPECT_EQ(hit->bound(), LOWER);
+
+    EXPECT_FALSE(tt.probe(hash ^ (1ULL << 63)).has_value());
+}
+
+TEST(TranspositionTable, RewriteKeepsCachedEval)
+{
+    tt_t tt;
+    ASSERT_TRUE(tt.init(1));
+
+    const hash_t hash = 0x0fedcba987654321ULL;
+    tt.store(hash, 3, 10, UPPER, Move::none(), -57);
+    tt.store(hash, 5, 20, EXACT, Move::make<NORMAL>(G1, F3));
+
+    const auto hit = tt.probe(hash);
+    ASSERT_TRUE(hit.has_value());
+    EXPECT_EQ(hit->m_score, 20);
+    EXPECT_EQ(hit->m_eval, -57);
+}
+
+TEST(TranspositionTable, ClusterKeepsCollidingPositions)
+{
+    tt_t tt;
+    ASSERT_TRUE(tt.init(1));
+
+    // same high bits means same cluster
+    for (hash_t i = 1; i <= tt_cluster_t::N_ENTRIES; ++i)
+    {
+        tt.store(i, static_cast<int>(i), 0, EXACT, Move::none());
+    }
+    for (hash_t i = 1; i <= tt_cluster_t::N_ENTRIES; ++i)
+    {
+        EXPECT_TRUE(tt.probe(i).has_value()) << "entry " << i << " was evicted";
+    }
+}
+
+TEST(TranspositionTable, ReplacesShallowestOldestEntry)
+{
+    tt_t tt;
+    ASSERT_TRUE(tt.init(1));
+    tt.new_generation();
+
+    for (hash_t i = 1; i <= tt_cluster_t::N_ENTRIES; ++i)
+    {
+        tt.store(i, 10 + static_cast<int>(i), 0, EXACT, Move::none());
+    }
+    tt.new_generation();
+    tt.store(42, 1, 0, EXACT, Move::none());
+
+    EXPECT_TRUE(tt.probe(42).has_value());
+    EXPECT_FALSE(tt.probe(1).has_value());
+    for (hash_t i = 2; i <= tt_cluster_t::N_ENTRIES; ++i)
+    {
+        EXPECT_TRUE(tt.probe(i).has_value());
+    }
+}
+
+TEST(TranspositionTable, TornEntryIsAMiss)
+{
+    const hash_t hash = 0xfeedfacecafebeefULL;
+    tt_entry_t   entry;
+    entry.write(hash, tt_data_t(5, 100, 20, EXACT, 1, Move::make<NORMAL>(G1, F3)));
+    ASSERT_TRUE(entry.read(hash).has_value());
+
+    // payload of a concurrent write landing without its key
+    tt_entry_t other;
+    other.write(hash, tt_data_t(9, -300, 20, LOWER, 1, Move::make<NORMAL>(B1, C3)));
+    entry.m_data = other.m_data;
+
+    EXPECT_FALSE(entry.read(hash).has_value());
+}
+
+TEST(TranspositionTable, ParallelResetClearsEverySlice)
+{
+    tt_t tt;
+    ASSERT_TRUE(tt.init(2, 3));
+
+    std::vector<hash_t> hashes;
+    for (hash_t i = 1; i <= 1000; ++i)
+    {
+        hashes.push_back(i * 0x9e3779b97f4a7c15ULL);
+        tt.store(hashes.back(), 3, 0, EXACT, Move::none());
+    }
+    tt.reset(3);
+
+    for (const auto h : hashes)
+    {
+        EXPECT_FALSE(tt.probe(h).has_value());
+    }
+}
+
+TEST(TranspositionTable, HashfullCountsCurrentGeneration)
+{
+    tt_t tt;
+    ASSERT_TRUE(tt.init(1));
+    tt.new_generation();
+    EXPECT_EQ(tt.hashfull(), 0);
+
+    for (hash_t i = 1; i <= 200000; ++i)
+    {
+        tt.store(i * 0x9e3779b97f4a7c15ULL, 3, 0, EXACT, Move::none());
+    }
+    EXPECT_GT(tt.hashfull(), 900);
+
+    tt.new_generation();
+    EXPECT_EQ(tt.hashfull(), 0);
+}
+
+TEST(TranspositionTable, FailedResizeKeepsTable)
+{
+    tt_t tt;
+    ASSERT_TRUE(tt.init(1));
+    tt.store(0xabcdef0123456789ULL, 12, 35, EXACT, Move::make<NORMAL>(D2, D4), -7);
+
+    // far more than any machine has, the allocation fails and the table stays usable
+    EXPECT_FALSE(tt.init(size_t{1} << 40));
+    EXPECT_EQ(tt.size_mb(), 1u);
+    EXPECT_TRUE(tt.probe(0xabcdef0123456789ULL).has_value());
+    tt.reset();
+    EXPECT_FALSE(tt.probe(0xabcdef0123456789ULL).has_value());
+}
+
+TEST(TranspositionTable, SaveThenLoad)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "chepp_tt_test.tt").string();
+
+    tt_t saved;
+    ASSERT_TRUE(saved.init(1));
+    saved.new_generation();
+    saved.store(0xabcdef0123456789ULL, 12, 35, EXACT, Move::make<NORMAL>(D2, D4), -7);
+    ASSERT_TRUE(saved.save(path, NET_HASH));
+
+    // a table of another size than the file is left alone
+    tt_t other;
+    ASSERT_TRUE(other.init(4));
+    other.store(0x1111111111111111ULL, 5, 10, LOWER, Move::none(), 3);
+    EXPECT_FALSE(other.load(path, NET_HASH));
+    EXPECT_EQ(other.size_mb(), 4u);
+    EXPECT_TRUE(other.probe(0x1111111111111111ULL).has_value());
+
+    tt_t loaded;
+    ASSERT_TRUE(loaded.init(1));
+    ASSERT_TRUE(loaded.load(path, NET_HASH));
+    EXPECT_EQ(loaded.size_mb(), saved.size_mb());
+
+    const auto hit = loaded.probe(0xabcdef0123456789ULL);
+    ASSERT_TRUE(hit.has_value());
+    EXPECT_EQ(hit->m_depth, 12);
+    EXPECT_EQ(hit->m_score, 35);
+    EXPECT_EQ(hit->m_eval, -7);
+    EXPECT_EQ(hit->m_move, Move::make<NORMAL>(D2, D4));
+
+    // a file written with other zobrist keys is rejected
+    {
+        std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+        tt_file_header_t header{};
+        f.read(reinterpret_cast<char*>(&header), sizeof(header));
+        header.m_zobrist ^= 1;
+        f.seekp(0);
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    EXPECT_FALSE(loaded.load(path, NET_HASH));
+    EXPECT_TRUE(loaded.probe(0xabcdef0123456789ULL).has_value());
+
+    std::filesystem::remove(path);
+}
+
+TEST(TranspositionTable, TruncatedFileKeepsTable)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "chepp_tt_truncated.tt").string();
+
+    tt_t saved;
+    ASSERT_TRUE(saved.init(1));
+    ASSERT_TRUE(saved.save(path, NET_HASH));
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - sizeof(tt_cluster_t));
+
+    tt_t loaded;
+    ASSERT_TRUE(loaded.init(1));
+    loaded.store(0xabcdef0123456789ULL, 12, 35, EXACT, Move::make<NORMAL>(D2, D4), -7);
+    EXPECT_FALSE(loaded.load(path, NET_HASH));
+    EXPECT_TRUE(loaded.probe(0xabcdef0123456789ULL).has_value());
+
+    std::filesystem::remove(path);
+}
+
+TEST(TranspositionTable, OtherNetIsRejected)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "chepp_tt_net.tt").string();
+
+    tt_t saved;
+    ASSERT_TRUE(saved.init(1));
+    saved.store(0xabcdef0123456789ULL, 12, 35, EXACT, Move::make<NORMAL>(D2, D4), -7);
+    ASSERT_TRUE(saved.save(path, NET_HASH));
+
+    // the evals in the file belong to another net
+    tt_t loaded;
+    ASSERT_TRUE(loaded.init(1));
+    EXPECT_FALSE(loaded.load(path, NET_HASH ^ 1));
+    EXPECT_FALSE(loaded.probe(0xabcdef0123456789ULL).has_value());
+    EXPECT_TRUE(loaded.load(path, NET_HASH));
+    EXPECT_TRUE(loaded.probe(0xabcdef0123456789ULL).has_value());
+
+    std::filesystem::remove(path);
+}
@@ -48,3 +48,28 @@ TEST(ZobristTranspositions, CastlingRightsAffectHash) {
 }
 
 
+
+
+static void check_key_after(const Position& pos, const int depth)
+{
+    EXPECT_EQ(pos.key_after(Move::null()), Position(pos, Move::null()).hash()) << pos;
+    for (const auto [move, _] : gen_legal(pos))
+    {
+        const Position next{pos, move};
+        ASSERT_EQ(pos.key_after(move), next.hash()) << pos << move;
+        if (depth > 1)
+            check_key_after(next, depth - 1);
+    }
+}
+
+TEST(ZobristTranspositions, KeyAfterMatchesDoMove) {
+    for (const auto fen : {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+                           "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+                           "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+                           "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"})
+    {
+        Position pos;
+        pos.from_fen(fen);
+        check_key_after(pos, 3);
+    }
+}
@@ -44,9 +44,24 @@ public:
 
     [[nodiscard]] T value() const { return m_value; }
 
+    // for options that have to act on the engine (resize a table...) rather than just being read later
+    // a callback that fails gets the option back to its previous value
+    using Callback = std::function<bool(const T&)>;
+    void on_change(Callback cb) { m_on_change = std::move(cb); }
+
 protected:
+    bool set_value(T value)
+    {
+        std::swap(m_value, value);
+        if (!m_on_change || m_on_change(m_value))
+            return true;
+        m_value = std::move(value);
+        return false;
+    }
+
     T m_init{};;
     T& m_value{};
+    Callback m_on_change{};
 };
 
 class EngineParamCheck final : public ValueEngineParameter<bool> {
@@ -59,8 +74,8 @@ public:
     }
 
     bool parse(const std::string& v) override {
-        if (v == "true" || v == "1") { m_value = true; return true; }
-        if (v == "false" || v == "0") { m_value = false; return true; }
+        if (v == "true" || v == "1") return set_value(true);
+        if (v == "false" || v == "0") return set_value(false);
         return false;
     }
 
@@ -79,12 +94,12 @@ public:
     }
 
     bool parse(const std::string& v) override {
+        int val;
         try {
-            int val = std::stoi(v);
-            if (val < m_min || val > m_max) return false;
-            m_value = val;
-            return true;
+            val = std::stoi(v);
         } catch (...) { return false; }
+        if (val < m_min || val > m_max) return false;
+        return set_value(val);
     }
 
     [[nodiscard]] std::string value_str() const override { return std::to_string(m_value); }
@@ -106,10 +121,8 @@ public:
     }
 
     bool parse(const std::string& v) override {
-        if (std::ranges::find(m_choices, v) != m_choices.end()) {
-            m_value = v;
-            return true;
-        }
+        if (std::ranges::find(m_choices, v) != m_choices.end())
+            return set_value(v);
         return false;
     }
 
@@ -128,7 +141,7 @@ public:
         return "option name " + m_name + " type string default " + m_init;
     }
 
-    bool parse(const std::string& v) override { m_value = v; return true; }
+    bool parse(const std::string& v) override { return set_value(v); }
 
     [[nodiscard]] std::string value_str() const override { return m_value; }
 };
@@ -232,6 +245,9 @@ class UCIEngine {
     {
         int hash_size{};
         int threads{};
+        bool numa_interleave{};
+        std::string hash_file{};
+        std::string eval_file{};
         EngineParameters handler{};
     };
 
@@ -252,15 +268,72 @@ class UCIEngine {
 
 public:
     UCIEngine() {
-        m_params.handler.add<EngineParamSpin>("Hash Size", m_params.hash_size, 64, 64, 512);
+        // hash is in MB, the max (32 TB) is only there to keep mb * 2^20 well inside size_t
+        auto* hash = m_params.handler.add<EngineParamSpin>("Hash", m_params.hash_size, 512, 1, 33554432);
+        hash->on_change([this](const int mb) {
+            if (g_tt.init(mb, m_params.threads))
+                return true;
+            std::cout << "info string Could not allocate " << mb << " MB for the hash, keeping " << g_tt.size_mb()
+                      << " MB" << std::endl;
+            return false;
+        });
         m_params.handler.add<EngineParamSpin>("Threads", m_params.threads, 1, 1, std::thread::hardware_concurrency());
-        m_params.handler.add<EngineParamButton>("Clear Hash", []() {
-            g_tt.reset();
+        auto* numa = m_params.handler.add<EngineParamCheck>("NUMA Interleave", m_params.numa_interleave, false);
+        numa->on_change([this](const bool v) {
+            g_tt.set_numa_interleave(v);
+            if (g_tt.init(g_tt.size_mb(), m_params.threads))
+                return true;
+            g_tt.set_numa_interleave(!v);
+            std::cout << "info string Could not reallocate the hash, NUMA Interleave left unchanged" << std::endl;
+            return false;
+        });
+        m_params.handler.add<EngineParamButton>("Clear Hash", [this]() {
+            g_tt.reset(m_params.threads);
             std::cout << "info string Hash cleared" << std::endl;
             return true;
         });
+        // long analysis sessions can keep their table across engine restarts
+        m_params.handler.add<EngineParamString>("Hash File", m_params.hash_file, "chepp.tt");
+        m_params.handler.add<EngineParamButton>("Save Hash", [this]() {
+            const bool ok = g_tt.save(m_params.hash_file, g_net.payload_hash());
+            std::cout << "info string " << (ok ? "Hash saved to " : "Could not save hash to ") << m_params.hash_file
+                      << std::endl;
+            return ok;
+        });
+        m_params.handler.add<EngineParamButton>("Load Hash", [this]() {
+            const bool ok = g_tt.load(m_params.hash_file, g_net.payload_hash());
+            if (ok)
+                std::cout << "info string Hash loaded from " << m_params.hash_file << " (" << g_tt.size_mb() << " MB)"
+                          << std::endl;
+            else
+                std::cout << "info string Could not load hash from " << m_params.hash_file
+                          << ", it must be a complete file saved with the current Hash size and network" << std::endl;
+            return ok;
+        });
+        // nets can be swapped without a rebuild, the embedded one stays as the fallback
+        auto* eval_file = m_params.handler.add<EngineParamString>("EvalFile", m_params.eval_file,
+                                                                  std::string(Network::EMBEDDED));
+        // the tt caches raw evals of the previous net, they must not outlive it
+        eval_file->on_change([this](const std::string& path) {
+            g_tt.reset(m_params.threads);
+            if (path.empty() || path == Network::EMBEDDED)
+                g_net.use_embedded();
+            else if (!g_net.load(path))
+            {
+                std::cout << "info string Could not load network " << path << ", using the embedded one" << std::endl;
+                g_net.use_embedded();
+                return true;
+            }
+            std::cout << "info string Network " << g_net.name() << " hash " << std::hex << g_net.hash() << std::dec
+                      << std::endl;
+            return true;
+        });
         m_pos.init_pos.from_fen(start_fen);
         m_pos.last_pos.from_fen(start_fen);
+
+        // the default may not fit on a small machine, halve it until it does
+        while (!g_tt.init(m_params.hash_size, m_params.threads) && m_params.hash_size > 1)
+            m_params.hash_size /= 2;
     }
 
     void uci() const
@@ -279,7 +352,7 @@ public:
 
     void ucinewgame() {
         if (m_state != Waiting) return;
-        g_tt.reset();
+        g_tt.reset(m_params.threads);
     }
 
     void position(const std::string& cmd) {
@@ -4,9 +4,17 @@
 #include <array>
 #include <cassert>
 #include <cstdlib>
-#include <random>
 #include <string>
 
+// with bmi2 slider attacks are indexed with pext instead of a magic multiplication
+// pext is microcoded on amd before zen 3, CHEPP_NO_PEXT keeps the magics on those
+#if defined(__BMI2__) && !defined(CHEPP_NO_PEXT)
+#include <immintrin.h>
+#define CHEPP_PEXT 1
+#else
+#define CHEPP_PEXT 0
+#endif
+
 class Bitboard
 {
   public:
@@ -339,6 +347,45 @@ constexpr Bitboard relevancy_mask(const Square sq)
     return ray<pc>(sq) & mask;
 }
 
+// magics for the multiply and shift index, found offline once for the shifts below
+// a multiplication by a magic maps every blocker subset of a mask to a slot that is either free or holds the same attacks
+inline constexpr std::array<Bitboard::U64, 64> BISHOP_MAGICS = {
+    0x0340101a24404080ULL, 0x4011022481060462ULL, 0x0808422410200083ULL, 0xc284104a001801c0ULL,
+    0x2301104028000a00ULL, 0x0000822020044890ULL, 0x0000808410400084ULL, 0x0082008084108200ULL,
+    0x0100102102188200ULL, 0x020560020cc20481ULL, 0x0002100090810038ULL, 0x0001040418900010ULL,
+    0x0221821210000012ULL, 0x0000071008040000ULL, 0x08040484500814a0ULL, 0x248501440c010890ULL,
+    0x8011102912081800ULL, 0x00e0908242440104ULL, 0x8570000802212020ULL, 0x0000800802810008ULL,
+    0x000a004c12020001ULL, 0x0097000210008400ULL, 0x1040930208040204ULL, 0x0002888100513000ULL,
+    0x0020880010108110ULL, 0x8008044808812800ULL, 0x0084020040408100ULL, 0x0054080018202140ULL,
+    0x0011001085004008ULL, 0x002804c032030084ULL, 0x4090920024054c06ULL, 0x0c40802002021220ULL,
+    0x0a042004094a1004ULL, 0x0408240420100122ULL, 0x0200108881100400ULL, 0x081ba00800010104ULL,
+    0x1a01100400208020ULL, 0x80a0a80200004100ULL, 0xc014880ac0108420ULL, 0x1801192204002200ULL,
+    0xa2042144c0241012ULL, 0x100c880802080880ULL, 0x0402041404020200ULL, 0xb805010411020802ULL,
+    0xc000400903000210ULL, 0x8841102110400200ULL, 0x000801110a000400ULL, 0x0002481049008080ULL,
+    0x0001082805040000ULL, 0x0102084c04740404ULL, 0x0008110041100100ULL, 0x004180802a080004ULL,
+    0x0020024810242004ULL, 0x0800220421120000ULL, 0x0291302a80840040ULL, 0x0008080120420004ULL,
+    0x000c208404014050ULL, 0x1201008080901000ULL, 0x0000000042009068ULL, 0x0080980004208800ULL,
+    0x08c2214020602480ULL, 0x0c002008a0084084ULL, 0x0010400421040110ULL, 0x02848400820a0600ULL,
+};
+inline constexpr std::array<Bitboard::U64, 64> ROOK_MAGICS = {
+    0x0280088051a0c000ULL, 0x0040001000200042ULL, 0x02002080400a0010ULL, 0x6500100088042100ULL,
+    0x0100020800041100ULL, 0x2200020005449018ULL, 0xa080010000800200ULL, 0xca0001840c420123ULL,
+    0x0300802040008000ULL, 0x0010804000802000ULL, 0x2021802001100082ULL, 0x0020801000840802ULL,
+    0x2201000500120800ULL, 0x100300080b000400ULL, 0x3806800600170080ULL, 0x8002000100820044ULL,
+    0x8000818000400020ULL, 0x0208810030400100ULL, 0x4000888020021000ULL, 0x1800090020100100ULL,
+    0x0040050011000800ULL, 0x0249010002040008ULL, 0x1000440010080102ULL, 0x400206000508a844ULL,
+    0x0010800280244000ULL, 0x0108200440005000ULL, 0x000901c100142004ULL, 0x0010880280100080ULL,
+    0x0216080080040080ULL, 0x9002020080040080ULL, 0x0002000200040801ULL, 0x0212005200140081ULL,
+    0x6680614002800186ULL, 0x4220004000802080ULL, 0x0100110041002001ULL, 0x44c0801002800801ULL,
+    0x0865000801000410ULL, 0x0002000400800280ULL, 0x0000821004002841ULL, 0x0000800040800100ULL,
+    0x0240800040008020ULL, 0x4010420900820021ULL, 0x0020010220490010ULL, 0xa008008010028008ULL,
+    0x80220004508a0020ULL, 0x2000020004008080ULL, 0x9c00010802040010ULL, 0x04010000a0410012ULL,
+    0x84008000c300e500ULL, 0x0042004020810200ULL, 0x0020001000882080ULL, 0x8005100080480180ULL,
+    0x0818040080080080ULL, 0x2004010040020040ULL, 0x0000080250010400ULL, 0x002008440118a200ULL,
+    0x1006028111006042ULL, 0x0040204000810011ULL, 0x0300100a00204082ULL, 0x4042000410200842ULL,
+    0x2002000820041002ULL, 0x0812004804011082ULL, 0xa6005001120800a4ULL, 0x04081900840022c2ULL,
+};
+
 template <PieceType pc>
 struct magics_t
 {
@@ -354,9 +401,32 @@ struct magics_t
         index_type               offset{};
         [[nodiscard]] index_type index(const Bitboard blockers) const
         {
+#if CHEPP_PEXT
+            return offset + static_cast<index_type>(_pext_u64(blockers.value(), mask.value()));
+#else
             return offset + (((blockers & mask).value() * magic) >> shift);
+#endif
         }
     };
+
+    // everything but the attacks themselves is known at compile time
+    static constexpr EnumArray<Square, magic_val_t> magic_vals = []()
+    {
+        static_assert(pc == BISHOP || pc == ROOK);
+        EnumArray<Square, magic_val_t> ret{};
+        typename magic_val_t::index_type offset{0};
+        for (auto sq = A1; sq <= H8; ++sq)
+        {
+            const Bitboard mask = relevancy_mask<pc>(sq);
+            ret.at(sq).mask     = mask;
+            ret.at(sq).magic    = pc == BISHOP ? BISHOP_MAGICS.at(sq.index()) : ROOK_MAGICS.at(sq.index());
+            ret.at(sq).shift    = 64 - mask.popcount();
+            ret.at(sq).offset   = offset;
+            offset += 1U << mask.popcount();
+        }
+        return ret;
+    }();
+
     static constexpr std::size_t sz = [] ()
     {
         size_t ret = 0;
@@ -373,8 +443,7 @@ struct magics_t
     {
         return attacks[magic_vals[sq].index(occupancy)];
     }
-    EnumArray<Square, magic_val_t> magic_vals;
-    std::array<Bitboard, sz>       attacks;
+    std::array<Bitboard, sz> attacks;
 };
 
 template <PieceType pc>
@@ -395,88 +464,19 @@ inline const magics_t<ROOK>& magics<ROOK>() {
     return instance;
 }
 
-static uint64_t       random_u64()
-{
-    static std::random_device                      rd;
-    static std::mt19937                            gen(rd());
-    static std::uniform_int_distribution<uint64_t> dist(0, UINT64_MAX);
-    return dist(gen);
-}
-
-static uint64_t random_magic()
-{
-    return random_u64() & random_u64() & random_u64();
-}
-
-constexpr Bitboard mask_nb(const Bitboard mask, const uint64_t n)
-{
-    Bitboard bb{0};
-    int      idx = 0;
-    for (auto sq = A1; sq <= H8; ++sq)
-    {
-        if (Bitboard(sq) & mask)
-        {
-            if (Bitboard{n}.is_set(idx++))
-            {
-                bb |= Bitboard(sq);
-            }
-        }
-    }
-    return bb;
-}
-
 template <PieceType pc>
 magics_t<pc>::magics_t()
 {
-    constexpr uint64_t               MAX_TRIES{UINT64_MAX};
-    constexpr uint64_t               MAX_COMB{4096};
-    std::array<Bitboard, MAX_COMB>   cached_blockers{};
-    std::array<Bitboard, MAX_COMB>   cached_attacks{};
-    typename magic_val_t::index_type offset{0};
+    // no search left, every blocker subset of each mask is visited once with the carry rippler trick
     for (auto sq = A1; sq <= H8; ++sq)
     {
-        const typename magic_val_t::mask_type  mask{relevancy_mask<pc>(sq)};
-        const int                              nb_ones{mask.popcount()};
-        const int                              combinations{1 << nb_ones};
-        const typename magic_val_t::shift_type shift{64 - nb_ones};
-        typename magic_val_t::magic_type       magic{0};
-        assert(combinations <= MAX_COMB && "to many blockers variations, check relevancy mask");
-        for (int comb = 0; comb < combinations; comb++)
-        {
-            cached_blockers.at(comb) = mask_nb(mask, comb);
-            cached_attacks.at(comb)  = ray<pc>(sq, cached_blockers.at(comb));
-        }
-        for (uint64_t tries = 1;; tries++)
+        const magic_val_t& m        = magic_vals.at(sq);
+        Bitboard           blockers = bb::empty();
+        do
         {
-            std::array<bool, MAX_COMB> tries_map{};
-            bool                       fail{false};
-            magic = random_magic();
-            for (int c = 0; c < combinations; c++)
-            {
-                const typename magic_val_t::index_type index = (cached_blockers.at(c).value() * magic) >> shift;
-                if (const Bitboard cur = attacks.at(offset + index);
-                    tries_map.at(index) && (cur != cached_attacks.at(c)))
-                {
-                    fail = true;
-                    break;
-                }
-                attacks.at(offset + index) = cached_attacks.at(c);
-                tries_map.at(index)        = true;
-            }
-            if (!fail)
-            {
-                break;
-            }
-            if (tries == MAX_TRIES - 1)
-            {
-                assert(0 && "failed to find magic");
-            }
-        }
-        magic_vals.at(sq).offset = offset;
-        magic_vals.at(sq).magic  = magic;
-        magic_vals.at(sq).mask   = mask;
-        magic_vals.at(sq).shift  = shift;
-        offset += combinations;
+            attacks.at(m.index(blockers)) = ray<pc>(sq, blockers);
+            blockers                      = Bitboard{(blockers.value() - m.mask.value()) & m.mask.value()};
+        } while (blockers);
     }
 }
 
@@ -5,6 +5,7 @@
 #ifndef HISTORY_H
 #define HISTORY_H
 
+#include "movegen.h"
 #include "position.h"
 #include <memory>
 #include <vector>
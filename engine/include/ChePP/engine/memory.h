@@ -0,0 +1,192 @@
+//
+// Created by paul on 10/16/26.
+//
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// a big zero-initialisable buffer backed by huge pages when the os gives us some
+// used for tables that are probed at random (tt), where 4K pages make every probe a tlb miss
+class LargePageBuffer
+{
+  public:
+    static constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    LargePageBuffer() = default;
+    explicit LargePageBuffer(const std::size_t bytes, const bool numa_interleave = false)
+    {
+        allocate(bytes, numa_interleave);
+    }
+
+    LargePageBuffer(const LargePageBuffer&)            = delete;
+    LargePageBuffer& operator=(const LargePageBuffer&) = delete;
+    LargePageBuffer(LargePageBuffer&& o) noexcept { swap(o); }
+    LargePageBuffer& operator=(LargePageBuffer&& o) noexcept
+    {
+        LargePageBuffer tmp{std::move(o)};
+        swap(tmp);
+        return *this;
+    }
+    ~LargePageBuffer() { release(); }
+
+    [[nodiscard]] void*       data() { return m_data; }
+    [[nodiscard]] const void* data() const { return m_data; }
+    [[nodiscard]] std::size_t size() const { return m_bytes; }
+    [[nodiscard]] bool        huge_pages() const { return m_huge; }
+
+  private:
+    void swap(LargePageBuffer& o) noexcept
+    {
+        std::swap(m_data, o.m_data);
+        std::swap(m_bytes, o.m_bytes);
+        std::swap(m_mapped, o.m_mapped);
+        std::swap(m_huge, o.m_huge);
+    }
+
+    void allocate(std::size_t bytes, const bool numa_interleave)
+    {
+        // rounding to whole huge pages lets the kernel back the tail with a huge page as well
+        bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+#if defined(__linux__)
+        // explicit huge pages first, they only exist if the admin reserved some (vm.nr_hugepages)
+        void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED)
+        {
+            m_mapped = true;
+            m_huge   = true;
+        }
+        else
+        {
+            // otherwise ask for transparent huge pages on a huge page aligned block
+            mem = std::aligned_alloc(HUGE_PAGE_SIZE, bytes);
+            if (!mem)
+                throw std::bad_alloc();
+            m_huge = madvise(mem, bytes, MADV_HUGEPAGE) == 0;
+        }
+        if (numa_interleave)
+            interleave(mem, bytes);
+#else
+        void* mem = ::operator new(bytes, std::align_val_t{HUGE_PAGE_SIZE});
+#endif
+        m_data  = mem;
+        m_bytes = bytes;
+    }
+
+    void release() noexcept
+    {
+        if (!m_data)
+            return;
+#if defined(__linux__)
+        if (m_mapped)
+            munmap(m_data, m_bytes);
+        else
+            std::free(m_data);
+#else
+        ::operator delete(m_data, std::align_val_t{HUGE_PAGE_SIZE});
+#endif
+        m_data  = nullptr;
+        m_bytes = 0;
+    }
+
+#if defined(__linux__)
+    // spread pages round robin over every node we may allocate on
+    // must happen before the first touch, pages are placed when they are faulted in
+    // raw syscalls so we do not need libnuma, failure only means we keep the default first touch policy
+    static void interleave(void* mem, const std::size_t bytes)
+    {
+        constexpr int      MPOL_INTERLEAVE_     = 3;
+        constexpr unsigned MPOL_F_MEMS_ALLOWED_ = 1 << 2;
+        constexpr unsigned long MAX_NODES       = 64;
+
+        unsigned long nodes = 0;
+        if (syscall(SYS_get_mempolicy, nullptr, &nodes, MAX_NODES, nullptr, MPOL_F_MEMS_ALLOWED_) != 0)
+            return;
+        if (__builtin_popcountl(nodes) < 2)
+            return;
+        syscall(SYS_mbind, mem, bytes, MPOL_INTERLEAVE_, &nodes, MAX_NODES, 0);
+    }
+#endif
+
+    void*       m_data   = nullptr;
+    std::size_t m_bytes  = 0;
+    bool        m_mapped = false;
+    bool        m_huge   = false;
+};
+
+// a whole file mapped read only and shared: every process mapping the same file uses the same physical pages
+// only on linux for now, elsewhere the mapping always fails and callers take their fallback path
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path)
+    {
+#if defined(__linux__)
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* mem = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (mem != MAP_FAILED)
+            {
+                m_data  = mem;
+                m_bytes = static_cast<std::size_t>(st.st_size);
+            }
+        }
+        // the mapping keeps its own reference to the file
+        close(fd);
+#else
+        (void)path;
+#endif
+    }
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& o) noexcept { swap(o); }
+    MappedFile& operator=(MappedFile&& o) noexcept
+    {
+        MappedFile tmp{std::move(o)};
+        swap(tmp);
+        return *this;
+    }
+    ~MappedFile()
+    {
+#if defined(__linux__)
+        if (m_data)
+            munmap(m_data, m_bytes);
+#endif
+    }
+
+    [[nodiscard]] const void* data() const { return m_data; }
+    [[nodiscard]] std::size_t size() const { return m_bytes; }
+    explicit operator bool() const { return m_data != nullptr; }
+
+  private:
+    void swap(MappedFile& o) noexcept
+    {
+        std::swap(m_data, o.m_data);
+        std::swap(m_bytes, o.m_bytes);
+    }
+
+    void*       m_data  = nullptr;
+    std::size_t m_bytes = 0;
+};
+
+#endif // MEMORY_H
@@ -2,9 +2,17 @@
 #define MOVE_ORDERING_H
 
 #include "history.h"
+#include "movegen.h"
 #include "types.h"
 
 
+// most valuable victim first, the least valuable attacker breaks ties
+inline int mvv_lva(const Position& pos, const Move move)
+{
+    const int victim = move.type_of() == EN_PASSANT ? PAWN.piece_value() : pos.piece_at(move.to_sq()).piece_value();
+    return victim * 10 - pos.piece_at(move.from_sq()).piece_value() / 100;
+}
+
 inline void score_moves(const std::span<const Position> positions,
                         MoveList& list,
                         const Move prev_best,
@@ -28,7 +36,7 @@ inline void score_moves(const std::span<const Position> positions,
             auto victim   = pos.piece_at(move.to_sq());
 
             if (victim != NO_PIECE || move.type_of() == EN_PASSANT) {
-                score = pos.see(move) * 10;
+                score = mvv_lva(pos, move);
             } else {
                 auto back = std::min(2, int(positions.size()) - 1);
                 score += history.get_cont_hist_bonus(positions, move, back) + history.get_hist_bonus(pos, move);
@@ -39,4 +47,176 @@ inline void score_moves(const std::span<const Position> positions,
 }
 
 
+// hands out the pseudo legal moves of a node one at a time, most promising first
+// legality is left to the caller, a move pruned or never reached does not pay for it
+// the tt move is tried before anything is generated and quiets are only generated once every good capture
+// and killer failed to cut, each stage selects its next best move instead of sorting moves that may never be tried
+class MovePicker
+{
+  public:
+    MovePicker(const std::span<const Position> positions,
+               const Move tt_move,
+               const HistoryManager& history,
+               const SearchStackNode& ss)
+        : m_positions(positions), m_history(history), m_tt_move(tt_move), m_killer1(ss.killer1),
+          m_killer2(ss.killer2)
+    {
+    }
+
+    // Move::none() once every move was handed out
+    Move next()
+    {
+        const Position& pos = m_positions.back();
+        switch (m_stage)
+        {
+        case TT_MOVE:
+            m_stage = GEN_CAPTURES;
+            if (pos.is_pseudo_legal(m_tt_move))
+                return m_tt_move;
+            [[fallthrough]];
+
+        case GEN_CAPTURES:
+            gen_moves<CAPTURES>(pos, m_moves);
+            score_captures();
+            m_captures_end = m_moves.size();
+            m_stage        = GOOD_CAPTURES;
+            [[fallthrough]];
+
+        case GOOD_CAPTURES:
+            while (m_cur < m_captures_end)
+            {
+                const Move m = select(m_cur, m_captures_end).move;
+                if (m == m_tt_move)
+                {
+                    ++m_cur;
+                    continue;
+                }
+                // a losing capture waits until quiets had their chance, it is parked over the moves already handed
+                // out so the bad ones stay in the order they were selected
+                if (m.type_of() != PROMOTION && !pos.see_ge(m, 0))
+                {
+                    std::swap(m_moves[m_bad_end++], m_moves[m_cur++]);
+                    continue;
+                }
+                ++m_cur;
+                return m;
+            }
+            m_stage = KILLER_1;
+            [[fallthrough]];
+
+        case KILLER_1:
+            m_stage = KILLER_2;
+            if (is_killer_playable(m_killer1))
+                return m_killer1;
+            [[fallthrough]];
+
+        case KILLER_2:
+            m_stage = GEN_QUIETS;
+            if (m_killer2 != m_killer1 && is_killer_playable(m_killer2))
+                return m_killer2;
+            [[fallthrough]];
+
+        case GEN_QUIETS:
+            m_cur = m_moves.size();
+            gen_moves<QUIETS>(pos, m_moves);
+            score_quiets(m_cur);
+            m_stage = QUIETS_STAGE;
+            [[fallthrough]];
+
+        case QUIETS_STAGE:
+            while (m_cur < m_moves.size())
+            {
+                const Move m = select(m_cur, m_moves.size()).move;
+                ++m_cur;
+                if (m != m_tt_move && m != m_killer1 && m != m_killer2)
+                    return m;
+            }
+            m_cur   = 0;
+            m_stage = BAD_CAPTURES;
+            [[fallthrough]];
+
+        case BAD_CAPTURES:
+            if (m_cur < m_bad_end)
+                return m_moves[m_cur++].move;
+            m_stage = DONE;
+            [[fallthrough]];
+
+        case DONE:
+            break;
+        }
+        return Move::none();
+    }
+
+  private:
+    enum Stage
+    {
+        TT_MOVE,
+        GEN_CAPTURES,
+        GOOD_CAPTURES,
+        KILLER_1,
+        KILLER_2,
+        GEN_QUIETS,
+        QUIETS_STAGE,
+        BAD_CAPTURES,
+        DONE
+    };
+
+    // one pass of selection sort, moves the best of [begin, end) to begin
+    ScoredMove& select(const size_t begin, const size_t end)
+    {
+        size_t best = begin;
+        for (size_t i = begin + 1; i < end; ++i)
+        {
+            if (m_moves[i].score > m_moves[best].score)
+                best = i;
+        }
+        std::swap(m_moves[begin], m_moves[best]);
+        return m_moves[begin];
+    }
+
+    void score_captures()
+    {
+        const Position& pos = m_positions.back();
+        for (auto& [move, score] : m_moves)
+        {
+            if (move.type_of() == PROMOTION)
+                score = move.promotion_type().piece_value() * 8;
+            else
+                score = mvv_lva(pos, move);
+        }
+    }
+
+    void score_quiets(const size_t begin)
+    {
+        const Position& pos  = m_positions.back();
+        const int       back = std::min(2, static_cast<int>(m_positions.size()) - 1);
+        for (size_t i = begin; i < m_moves.size(); ++i)
+        {
+            const Move move   = m_moves[i].move;
+            m_moves[i].score = m_history.get_cont_hist_bonus(m_positions, move, back) +
+                               m_history.get_hist_bonus(pos, move);
+        }
+    }
+
+    // a killer comes from a sibling, it is only tried here if it is still a quiet move
+    [[nodiscard]] bool is_killer_playable(const Move killer) const
+    {
+        const Position& pos = m_positions.back();
+        return killer != m_tt_move && pos.is_pseudo_legal(killer) && !pos.is_occupied(killer.to_sq()) &&
+               killer.type_of() != EN_PASSANT && killer.type_of() != PROMOTION;
+    }
+
+    std::span<const Position> m_positions;
+    const HistoryManager&     m_history;
+    Move                      m_tt_move;
+    Move                      m_killer1;
+    Move                      m_killer2;
+    Stage                     m_stage{TT_MOVE};
+    MoveList                  m_moves{};
+    size_t                    m_cur{0};
+    size_t                    m_captures_end{0};
+    size_t                    m_bad_end{0};
+};
+
+
 #endif // MOVE_ORDERING_H
@@ -131,7 +131,19 @@ inline void add_promotions(MoveList& list, const Bitboard bb, const int delta)
     bb.for_each_square([&](const Square to) { make_all_promotions(list, to - delta, to); });
 }
 
-template <Color c>
+// which moves a generator call produces
+// captures also holds en passant and every promotion, quiets holds everything else
+// evasions is every move of a side in check, quiet checks the quiets that attack the enemy king directly
+enum gen_type_t : uint8_t
+{
+    CAPTURES,
+    QUIETS,
+    EVASIONS,
+    QUIET_CHECKS,
+    ALL_MOVES
+};
+
+template <Color c, gen_type_t T>
 void gen_pawn_moves(const Position& pos, MoveList& list)
 {
     constexpr auto up{relative_dir<c, NORTH>};
@@ -148,14 +160,23 @@ void gen_pawn_moves(const Position& pos, MoveList& list)
     const Bitboard     ep_bb      = pos.ep_square() == NO_SQUARE ? bb::empty() : bb(pos.ep_square());
 
     // straight
+    if constexpr (T != CAPTURES)
     {
         Bitboard single_push = shift<up>(pawns & ~bb_promotion_rank) & available;
         Bitboard double_push = shift<up>(single_push & bb_third_rank) & available & check_mask;
         single_push &= check_mask;
+        if constexpr (T == QUIET_CHECKS)
+        {
+            single_push &= pos.check_squares(PAWN);
+            double_push &= pos.check_squares(PAWN);
+        }
 
         add_moves_from_bb<NORMAL>(list, single_push, up);
         add_moves_from_bb<NORMAL>(list, double_push, up + up);
     }
+    if constexpr (T == QUIETS || T == QUIET_CHECKS)
+        return;
+
     // promotion
     if (const Bitboard promotions = pawns & bb_promotion_rank)
     {
@@ -192,17 +213,32 @@ void gen_pawn_moves(const Position& pos, MoveList& list)
     }
 }
 
-template <PieceType pc>
+// the squares pieces may land on for a generation type
+template <gen_type_t T>
+Bitboard gen_targets(const Position& pos, const Color c)
+{
+    if constexpr (T == CAPTURES)
+        return pos.occupancy(~c);
+    else if constexpr (T == QUIETS || T == QUIET_CHECKS)
+        return ~pos.occupancy();
+    else
+        return ~pos.occupancy(c);
+}
+
+template <PieceType pc, gen_type_t T>
 void gen_pc_moves(const Position& pos, MoveList& list)
 {
     const Color    c = pos.side_to_move();
     const Bitboard check_mask{pos.check_mask(c) == bb::empty() ? bb::full() : pos.check_mask(c)};
+    Bitboard       targets = gen_targets<T>(pos, c) & check_mask;
+    if constexpr (T == QUIET_CHECKS)
+        targets &= pos.check_squares(pc);
     Bitboard       bb{pos.occupancy(c, pc)};
 
     bb.for_each_square(
         [&](const Square from)
         {
-            Bitboard atk{attacks<pc>(from, pos.occupancy()) & ~pos.occupancy(c) & check_mask};
+            Bitboard atk{attacks<pc>(from, pos.occupancy()) & targets};
             atk.for_each_square([&](const Square to) { list.add(Move::make<NORMAL>(from, to)); });
         });
 }
@@ -237,78 +273,83 @@ inline void gen_castling(const Position& pos, MoveList& list)
     }
 }
 
-inline void gen_king_moves(const Position& pos, MoveList& list)
+template <gen_type_t T>
+void gen_king_moves(const Position& pos, MoveList& list)
 {
+    // a king never checks by itself
+    if constexpr (T == QUIET_CHECKS)
+        return;
+
     const Color    c     = pos.side_to_move();
     const Square   from  = pos.ksq(c);
     const Bitboard moves = attacks<KING>(from, pos.occupancy());
 
-    (moves & (~pos.occupancy() | pos.occupancy(~c))) // unoccupied or capture
-        .for_each_square([&](const Square to) { list.add(Move::make<NORMAL>(from, to)); });
+    (moves & gen_targets<T>(pos, c)).for_each_square([&](const Square to) { list.add(Move::make<NORMAL>(from, to)); });
 
-    gen_castling(pos, list);
+    if constexpr (T == QUIETS || T == ALL_MOVES)
+        gen_castling(pos, list);
 }
 
-template <Color c>
-MoveList gen_moves(const Position& pos)
+// appends to list so a caller can generate a second type behind the moves it already has
+template <Color c, gen_type_t T = ALL_MOVES>
+void gen_moves(const Position& pos, MoveList& list)
 {
-    MoveList  list;
     const int n_checkers = pos.checkers(c).popcount();
     assert(n_checkers <= 2);
+    assert(T != EVASIONS || n_checkers > 0);
 
     if (n_checkers != 2)
     {
-        gen_pawn_moves<c>(pos, list);
-        gen_pc_moves<BISHOP>(pos, list);
-        gen_pc_moves<KNIGHT>(pos, list);
-        gen_pc_moves<ROOK>(pos, list);
-        gen_pc_moves<QUEEN>(pos, list);
+        gen_pawn_moves<c, T>(pos, list);
+        gen_pc_moves<BISHOP, T>(pos, list);
+        gen_pc_moves<KNIGHT, T>(pos, list);
+        gen_pc_moves<ROOK, T>(pos, list);
+        gen_pc_moves<QUEEN, T>(pos, list);
     }
-    gen_king_moves(pos, list);
-    return list;
+    gen_king_moves<T>(pos, list);
 }
 
-inline MoveList gen_moves(const Position& pos)
+template <gen_type_t T = ALL_MOVES>
+void gen_moves(const Position& pos, MoveList& list)
 {
     if (pos.side_to_move() == WHITE)
-        return gen_moves<WHITE>(pos);
-    return gen_moves<BLACK>(pos);
+        gen_moves<WHITE, T>(pos, list);
+    else
+        gen_moves<BLACK, T>(pos, list);
 }
 
-inline MoveList gen_legal(const Position& pos)
+template <gen_type_t T = ALL_MOVES>
+MoveList gen_moves(const Position& pos)
 {
-    MoveList moves = gen_moves(pos);
-    moves.filter([&](const ScoredMove& mv) { return pos.is_legal(mv.move); });
-    return moves;
+    MoveList list;
+    gen_moves<T>(pos, list);
+    return list;
 }
 
-inline MoveList filter_tactical(const Position& pos, const MoveList& list)
+template <gen_type_t T = ALL_MOVES>
+MoveList gen_legal(const Position& pos)
 {
-    MoveList ret;
-    std::ranges::copy_if(list, std::back_inserter(ret),
-                         [&](const ScoredMove& mv)
-                         {
-                             return pos.is_occupied(mv.move.to_sq()) || mv.move.type_of() == EN_PASSANT ||
-                                    mv.move.type_of() == PROMOTION ||
-                                    attacks(pos.piece_type_at(mv.move.from_sq()), mv.move.to_sq(),
-                                            pos.occupancy() & ~Bitboard(mv.move.from_sq()), pos.side_to_move())
-                                        .is_set(pos.ksq(~pos.side_to_move()));
-                         });
-    return ret;
+    MoveList moves = gen_moves<T>(pos);
+    moves.filter([&](const ScoredMove& mv) { return pos.is_legal(mv.move); });
+    return moves;
 }
 
+// counts like the search plays: pseudo legal moves, each checked for legality only when it is reached
 inline void perft(const Position& prev, const int ply, size_t& out)
 {
-    MoveList l = gen_legal(prev);
-
-    if (ply == 1)
-    {
-        out += l.size();
-        return;
-    }
+    const MoveList l = gen_moves(prev);
 
     for (const auto [move, score] : l)
     {
+        if (!prev.is_legal(move))
+            continue;
+
+        if (ply == 1)
+        {
+            ++out;
+            continue;
+        }
+
         Position next{prev};
         next.do_move(move);
         perft(next, ply - 1, out);
@@ -0,0 +1,433 @@
+//
+// Created by paul on 10/16/26.
+//
+
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include "memory.h"
+#include "network_net.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// a net may carry several l1 / l2 / output stacks, one per output bucket, all sharing the feature transformer
+// format.txt describes them by sizing those layers for every bucket, stored [bucket][layer as for a single stack]
+// the bucket count is the size of the output bias, one value per bucket
+constexpr size_t network_layer_size(const std::string_view name)
+{
+    for (const auto& layer : g_network_layers)
+        if (name == layer.name)
+            return layer.size;
+    return 0;
+}
+
+inline constexpr size_t N_OUTPUT_BUCKETS = network_layer_size("g_out_bias");
+
+static_assert(N_OUTPUT_BUCKETS >= 1);
+static_assert(network_layer_size("g_l1_weights") == N_OUTPUT_BUCKETS * 2 * 1024 * 16);
+static_assert(network_layer_size("g_l1_biases") == N_OUTPUT_BUCKETS * 16);
+static_assert(network_layer_size("g_l2_weights") == N_OUTPUT_BUCKETS * 16 * 32);
+static_assert(network_layer_size("g_l2_biases") == N_OUTPUT_BUCKETS * 32);
+static_assert(network_layer_size("g_out_weights") == N_OUTPUT_BUCKETS * 32);
+
+// bucket of a position with that many pieces, kings included, spread evenly over 2 to 32 pieces
+constexpr size_t output_bucket(const int pieces)
+{
+    constexpr int per_bucket = (32 + N_OUTPUT_BUCKETS - 1) / N_OUTPUT_BUCKETS;
+    return std::min(static_cast<size_t>(std::max(pieces - 1, 0) / per_bucket), N_OUTPUT_BUCKETS - 1);
+}
+
+// l1 is read straight from the int16 layer of the net, [bucket][output][input]
+inline constexpr size_t L1_IN_SZ  = 2 * 1024;
+inline constexpr size_t L1_OUT_SZ = 16;
+
+// l2 weights widened and transposed to [bucket][input][output]: each l1 output is broadcast against every l2 output
+// so the layer accumulates one output per lane and never reduces horizontally
+struct L2Interleaved
+{
+    static constexpr size_t InSz  = 16;
+    static constexpr size_t OutSz = 32;
+
+    alignas(64) std::array<int32_t, N_OUTPUT_BUCKETS * InSz * OutSz> weights{};
+
+    void convert(const int16_t* src)
+    {
+        for (size_t b = 0; b < N_OUTPUT_BUCKETS; ++b)
+            for (size_t i = 0; i < OutSz; ++i)
+                for (size_t j = 0; j < InSz; ++j)
+                    weights[b * InSz * OutSz + j * OutSz + i] = src[b * InSz * OutSz + i * InSz + j];
+    }
+};
+
+// the weights of one output bucket, everything the layers after the feature transformer read
+struct NetworkHead
+{
+    const int16_t* l1_weights;
+    const int32_t* l1_biases;
+    const int32_t* l2_weights;
+    const int32_t* l2_biases;
+    const int16_t* out_weights;
+    int32_t        out_bias;
+};
+
+// optional header in front of a net, tools that write it get the payload checked on load
+// a raw net (layers back to back, like the trainer writes them) is accepted when its size matches exactly
+struct net_file_header_t
+{
+    static constexpr std::array<char, 8> MAGIC   = {'C', 'H', 'E', 'P', 'P', 'N', 'E', 'T'};
+    static constexpr uint32_t            VERSION = 1;
+
+    std::array<char, 8> m_magic{MAGIC};
+    uint32_t            m_version{VERSION};
+    uint32_t            m_layers{0};
+    uint64_t            m_payload_bytes{0};
+    uint64_t            m_payload_hash{0};
+};
+
+static_assert(sizeof(net_file_header_t) == 32);
+
+// everything the evaluation derives from the raw layers, stored as is in a blob
+struct NetworkTables
+{
+    L2Interleaved l2{};
+
+    void convert(const int16_t* l2_weights) { l2.convert(l2_weights); }
+};
+
+// a net laid out exactly like the engine uses it, ready to be mapped without any transformation
+// the derived tables depend on this build, so a blob only loads on the architecture and layout it was written for
+// layout: this header on its own page, the layers in 64 byte aligned slots, then the derived tables
+struct net_blob_header_t
+{
+    static constexpr std::array<char, 8> MAGIC     = {'C', 'H', 'E', 'P', 'P', 'B', 'L', 'B'};
+    static constexpr uint32_t            VERSION   = 1;
+    static constexpr size_t              PAGE_SIZE = 4096;
+
+    static constexpr std::array<char, 16> arch_tag()
+    {
+        std::array<char, 16> tag{};
+#if defined(__x86_64__)
+        constexpr std::string_view arch = "x86_64";
+#elif defined(__aarch64__)
+        constexpr std::string_view arch = "aarch64";
+#else
+        constexpr std::string_view arch = "generic";
+#endif
+        std::ranges::copy(arch, tag.begin());
+        tag[arch.size()] = std::endian::native == std::endian::little ? 'L' : 'B';
+        return tag;
+    }
+
+    std::array<char, 8>  m_magic{MAGIC};
+    uint32_t             m_version{VERSION};
+    uint32_t             m_layers{0};
+    std::array<char, 16> m_arch{arch_tag()};
+    uint64_t             m_layout_hash{0};
+    uint64_t             m_payload_hash{0};
+    uint64_t             m_file_bytes{0};
+};
+
+static_assert(sizeof(net_blob_header_t) <= net_blob_header_t::PAGE_SIZE);
+
+// the weights the evaluation reads: the embedded net, or one loaded at runtime through EvalFile
+// layers are taken from the generated layer table, which follows format.txt
+// must not change while a search is running
+struct Network
+{
+    static constexpr std::string_view EMBEDDED = "<embedded>";
+    static constexpr size_t           N_LAYERS = std::size(g_network_layers);
+
+    const int16_t* ft_weights  = nullptr;
+    const int16_t* ft_biases   = nullptr;
+    const int16_t* l1_weights  = nullptr;
+    const int32_t* l1_biases   = nullptr;
+    const int16_t* l2_weights  = nullptr;
+    const int32_t* l2_biases   = nullptr;
+    const int16_t* out_weights = nullptr;
+    const int32_t* out_bias    = nullptr;
+
+    // derived from the layers above, computed on load or read straight from a blob
+    const L2Interleaved* l2 = nullptr;
+
+    [[nodiscard]] NetworkHead head(const size_t bucket) const
+    {
+        return {&l1_weights[bucket * L1_IN_SZ * L1_OUT_SZ],
+                &l1_biases[bucket * L1_OUT_SZ],
+                &l2->weights[bucket * L2Interleaved::InSz * L2Interleaved::OutSz],
+                &l2_biases[bucket * L2Interleaved::OutSz],
+                &out_weights[bucket * L2Interleaved::OutSz],
+                out_bias[bucket]};
+    }
+
+    [[nodiscard]] const std::string& name() const { return m_name; }
+    [[nodiscard]] uint64_t           hash() const { return m_hash; }
+    [[nodiscard]] bool               mapped() const { return static_cast<bool>(m_mapping); }
+
+    void use_embedded()
+    {
+        bind([](const size_t i) { return g_network_layers[i].data; });
+        derive();
+        m_buffer  = LargePageBuffer{};
+        m_mapping = MappedFile{};
+        m_name    = EMBEDDED;
+        m_hash    = 0;
+    }
+
+    // a blob is mapped, anything else is read as a net file
+    // on failure the current net is kept
+    [[nodiscard]] bool load(const std::string& path)
+    {
+        std::array<char, 8> magic{};
+        std::ifstream(path, std::ios::binary).read(magic.data(), magic.size());
+        if (magic == net_blob_header_t::MAGIC)
+            return map_blob(path);
+        return read_net(path);
+    }
+
+    // must not overwrite the blob currently mapped, truncating it would pull the pages from under us
+    [[nodiscard]] bool save_blob(const std::string& path) const
+    {
+        if (mapped() && std::filesystem::equivalent(path, m_name))
+            return false;
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            return false;
+
+        net_blob_header_t header{};
+        header.m_layers       = N_LAYERS;
+        header.m_layout_hash  = layout_hash();
+        header.m_payload_hash = payload_hash();
+        header.m_file_bytes   = blob_bytes();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        const auto pad_to = [&out](const size_t offset)
+        {
+            while (static_cast<size_t>(out.tellp()) < offset)
+                out.put('\0');
+        };
+        for (size_t i = 0; i < N_LAYERS; ++i)
+        {
+            pad_to(net_blob_header_t::PAGE_SIZE + slot_offset(i));
+            out.write(static_cast<const char*>(m_layers[i]), static_cast<std::streamsize>(layer_bytes(i)));
+        }
+        pad_to(net_blob_header_t::PAGE_SIZE + tables_offset());
+        out.write(reinterpret_cast<const char*>(l2), sizeof(L2Interleaved));
+        return static_cast<bool>(out);
+    }
+
+    // identifies the weights, hashed on demand for the embedded net
+    [[nodiscard]] uint64_t payload_hash() const
+    {
+        if (m_hash != 0)
+            return m_hash;
+        uint64_t hash = FNV_OFFSET;
+        for (size_t i = 0; i < N_LAYERS; ++i)
+            hash = fnv1a(hash, static_cast<const char*>(m_layers[i]), layer_bytes(i));
+        return hash;
+    }
+
+    static constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+
+    static uint64_t fnv1a(uint64_t hash, const char* data, const size_t bytes)
+    {
+        for (size_t k = 0; k < bytes; ++k)
+        {
+            hash ^= static_cast<uint8_t>(data[k]);
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    static constexpr size_t layer_bytes(const size_t i)
+    {
+        return g_network_layers[i].type_size * g_network_layers[i].size;
+    }
+
+    static constexpr size_t payload_bytes()
+    {
+        size_t bytes = 0;
+        for (size_t i = 0; i < N_LAYERS; ++i)
+            bytes += layer_bytes(i);
+        return bytes;
+    }
+
+  private:
+    [[nodiscard]] bool read_net(const std::string& path)
+    {
+        std::error_code ec;
+        const auto      file_size = std::filesystem::file_size(path, ec);
+        std::ifstream   in(path, std::ios::binary);
+        if (ec || !in)
+            return false;
+
+        net_file_header_t header{};
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        const bool has_header = in && header.m_magic == net_file_header_t::MAGIC;
+        if (has_header)
+        {
+            if (header.m_version != net_file_header_t::VERSION || header.m_layers != N_LAYERS ||
+                header.m_payload_bytes != payload_bytes() || file_size != sizeof(header) + payload_bytes())
+                return false;
+        }
+        else
+        {
+            if (file_size != payload_bytes())
+                return false;
+            in.clear();
+            in.seekg(0);
+        }
+
+        // every layer gets a 64 byte aligned slot, whatever the packing in the file
+        LargePageBuffer buffer{slot_offset(N_LAYERS)};
+        auto*           base = static_cast<char*>(buffer.data());
+        uint64_t        hash = FNV_OFFSET;
+        for (size_t i = 0; i < N_LAYERS; ++i)
+        {
+            char*        dst   = base + slot_offset(i);
+            const size_t bytes = layer_bytes(i);
+            in.read(dst, static_cast<std::streamsize>(bytes));
+            if (!in)
+                return false;
+            hash = fnv1a(hash, dst, bytes);
+        }
+        if (has_header && hash != header.m_payload_hash)
+            return false;
+
+        m_buffer = std::move(buffer);
+        bind([base](const size_t i) -> const void* { return base + slot_offset(i); });
+        derive();
+        m_mapping = MappedFile{};
+        m_name    = path;
+        m_hash    = hash;
+        return true;
+    }
+
+    // the pages stay in the page cache and are shared by every process that maps the same blob
+    // nothing is hashed or converted here, the header is the only check
+    [[nodiscard]] bool map_blob(const std::string& path)
+    {
+        MappedFile file{path};
+        if (!file || file.size() < sizeof(net_blob_header_t))
+            return false;
+
+        net_blob_header_t header{};
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.m_magic != net_blob_header_t::MAGIC || header.m_version != net_blob_header_t::VERSION ||
+            header.m_layers != N_LAYERS || header.m_arch != net_blob_header_t::arch_tag() ||
+            header.m_layout_hash != layout_hash() || header.m_file_bytes != file.size() ||
+            file.size() != blob_bytes())
+            return false;
+
+        const auto* base = static_cast<const char*>(file.data()) + net_blob_header_t::PAGE_SIZE;
+        bind([base](const size_t i) -> const void* { return base + slot_offset(i); });
+        l2 = reinterpret_cast<const L2Interleaved*>(base + tables_offset());
+
+        m_mapping = std::move(file);
+        m_buffer  = LargePageBuffer{};
+        m_tables.reset();
+        m_name = path;
+        m_hash = header.m_payload_hash;
+        return true;
+    }
+
+    static constexpr size_t align_up(const size_t n) { return (n + 63) / 64 * 64; }
+
+    static constexpr size_t slot_offset(const size_t i)
+    {
+        size_t offset = 0;
+        for (size_t k = 0; k < i; ++k)
+            offset += align_up(layer_bytes(k));
+        return offset;
+    }
+
+    static constexpr size_t tables_offset() { return slot_offset(N_LAYERS); }
+
+    static constexpr size_t blob_bytes()
+    {
+        return net_blob_header_t::PAGE_SIZE + tables_offset() + sizeof(L2Interleaved);
+    }
+
+    // anything that changes where or how a blob stores its data changes this
+    static uint64_t layout_hash()
+    {
+        uint64_t   hash = FNV_OFFSET;
+        const auto mix  = [&hash](const uint64_t v) { hash = fnv1a(hash, reinterpret_cast<const char*>(&v), sizeof(v)); };
+        for (const auto& layer : g_network_layers)
+        {
+            hash = fnv1a(hash, layer.name, std::strlen(layer.name));
+            mix(layer.type_size);
+            mix(layer.size);
+        }
+        mix(N_OUTPUT_BUCKETS);
+        mix(sizeof(L2Interleaved));
+        mix(net_blob_header_t::PAGE_SIZE);
+        return hash;
+    }
+
+    static constexpr size_t index_of(const std::string_view name)
+    {
+        for (size_t i = 0; i < N_LAYERS; ++i)
+            if (name == g_network_layers[i].name)
+                return i;
+        return N_LAYERS;
+    }
+
+    template <typename T, typename At>
+    static const T* layer(const At& at, const std::string_view name)
+    {
+        const size_t i = index_of(name);
+        if (i == N_LAYERS || g_network_layers[i].type_size != sizeof(T))
+            std::abort();
+        return static_cast<const T*>(at(i));
+    }
+
+    template <typename At>
+    void bind(const At& at)
+    {
+        ft_weights  = layer<int16_t>(at, "g_ft_weights");
+        ft_biases   = layer<int16_t>(at, "g_ft_biases");
+        l1_weights  = layer<int16_t>(at, "g_l1_weights");
+        l1_biases   = layer<int32_t>(at, "g_l1_biases");
+        l2_weights  = layer<int16_t>(at, "g_l2_weights");
+        l2_biases   = layer<int32_t>(at, "g_l2_biases");
+        out_weights = layer<int16_t>(at, "g_out_weights");
+        out_bias    = layer<int32_t>(at, "g_out_bias");
+        for (size_t i = 0; i < N_LAYERS; ++i)
+            m_layers[i] = at(i);
+    }
+
+    // the tables are rebuilt in a fresh allocation, the ones in use are only released afterwards
+    void derive()
+    {
+        auto tables = std::make_unique<NetworkTables>();
+        tables->convert(l2_weights);
+        m_tables = std::move(tables);
+        l2       = &m_tables->l2;
+    }
+
+    std::array<const void*, N_LAYERS> m_layers{};
+    std::unique_ptr<NetworkTables>    m_tables{};
+    LargePageBuffer                   m_buffer{};
+    MappedFile                        m_mapping{};
+    std::string                       m_name{EMBEDDED};
+    uint64_t                          m_hash = 0;
+};
+
+inline Network g_net = []
+{
+    Network net;
+    net.use_embedded();
+    return net;
+}();
+
+#endif // NETWORK_H
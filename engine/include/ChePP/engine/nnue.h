@@ -3,20 +3,22 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <vector>
+#include <memory>
+#include <span>
 
-#include "network_net.h"
+#include "network.h"
 #include "position.h"
 
 template <typename T, size_t MaxSize>
 class ArrayStack
 {
-    std::array<T, MaxSize> data{};
+    std::array<T, MaxSize> items{};
     size_t                 topIndex = 0;
 
   public:
@@ -27,7 +29,7 @@ class ArrayStack
     {
         if (full())
             return false;
-        data[topIndex++] = value;
+        items[topIndex++] = value;
         return true;
     }
 
@@ -43,23 +45,26 @@ class ArrayStack
     {
         if (empty())
             throw std::underflow_error("Stack empty");
-        return data[topIndex - 1];
+        return items[topIndex - 1];
     }
 
     const T& top() const
     {
         if (empty())
             throw std::underflow_error("Stack empty");
-        return data[topIndex - 1];
+        return items[topIndex - 1];
     }
 
     size_t size() const { return topIndex; }
 
-    auto begin() { return data.begin(); }
-    auto end() { return data.begin() + topIndex; }
+    T*       data() { return items.data(); }
+    const T* data() const { return items.data(); }
 
-    auto begin() const { return data.begin(); }
-    auto end() const { return data.begin() + topIndex; }
+    auto begin() { return items.begin(); }
+    auto end() { return items.begin() + topIndex; }
+
+    auto begin() const { return items.begin(); }
+    auto end() const { return items.begin() + topIndex; }
 };
 
 struct FeatureTransformer
@@ -69,10 +74,22 @@ struct FeatureTransformer
     using RetT                       = ArrayStack<FeatureT, MaxChanges>;
 
     static constexpr size_t n_features_v = 16 * 12 * 64;
+    // 16 king buckets, each seen from the king side or mirrored
+    static constexpr size_t n_buckets_v = 16 * 2;
+
+    // every feature of a perspective depends on its king only through this
+    static int bucket(const Color view, const Square king_sq)
+    {
+        const int king_square = king_sq.value() ^ 56;
+        const int mirror      = !(king_square & 4);
+        const int oK          = (7 * mirror) ^ (56 * view.value()) ^ king_square;
+        return king_square_index(oK) * 2 + mirror;
+    }
 
+    // a king move inside its bucket is a plain incremental update
     static bool needs_refresh(const Position& cur, const Position& prev, const Color view)
     {
-        return prev.ksq(view) != cur.ksq(view);
+        return bucket(view, prev.ksq(view)) != bucket(view, cur.ksq(view));
     }
 
     static std::pair<RetT, RetT> get_features(const Position& cur, const Position& prev, const Color view,
@@ -144,10 +161,46 @@ struct FeatureTransformer
     }
 };
 
-#include <hwy/highway.h>
+// what changed for one perspective between a position and its parent
+// a king move changes every feature of its side, add then holds the full feature set
+struct DirtyFeatures
+{
+    FeatureTransformer::RetT add{};
+    FeatureTransformer::RetT rem{};
+    bool                     refresh = false;
+    uint8_t                  bucket  = 0;
+
+    static DirtyFeatures between(const Position& cur, const Position& prev, const Color view)
+    {
+        const bool refresh    = FeatureTransformer::needs_refresh(cur, prev, view);
+        const auto [add, rem] = FeatureTransformer::get_features(cur, prev, view, refresh);
+        return {add, rem, refresh, static_cast<uint8_t>(FeatureTransformer::bucket(view, cur.ksq(view)))};
+    }
+};
+
+// the SIMD kernels live in nnue_kernels.cpp, built for every target from the -march of the build up
+// and dispatched at runtime
+namespace nnue_kernels
+{
+    using FeatureT = FeatureTransformer::FeatureT;
+
+    void add_sub_1_1(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub);
+    void add_sub_1_2(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub);
+    void add_sub_2_2(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub);
+    void add_sub(int16_t* dst, const int16_t* src, const FeatureT* add, size_t n_add, const FeatureT* sub,
+                 size_t n_sub);
+
+    int32_t evaluate(const int16_t* us, const int16_t* them, size_t bucket);
+
+    // positions of the same output bucket evaluated together by evaluate_batch
+    inline constexpr size_t BATCH_SIZE = 8;
+    void evaluate_batch(const int16_t* const* us, const int16_t* const* them, size_t n, size_t bucket, int32_t* out);
 
-HWY_BEFORE_NAMESPACE();
-using namespace hwy::HWY_NAMESPACE;
+    // the instruction set the kernels run with on this cpu
+    const char* target_name();
+} // namespace nnue_kernels
+
+struct FinnyTable;
 
 struct Accumulator
 {
@@ -156,9 +209,14 @@ struct Accumulator
     static constexpr auto L2Sz  = 32;
     using AccumulatorT          = std::array<int16_t, OutSz>;
 
+    static_assert(L1_IN_SZ == 2 * OutSz && L1_OUT_SZ == L1Sz);
+    static_assert(L2Interleaved::InSz == L1Sz && L2Interleaved::OutSz == L2Sz);
+
   private:
-    HWY_ALIGN AccumulatorT white_accumulator{};
-    HWY_ALIGN AccumulatorT black_accumulator{};
+    alignas(64) AccumulatorT white_accumulator{};
+    alignas(64) AccumulatorT black_accumulator{};
+    // kings included, picks the output bucket
+    int pieces = 0;
 
   public:
     Accumulator() = default;
@@ -172,234 +230,294 @@ struct Accumulator
 
     explicit Accumulator(const Accumulator& acc_prev, const Position& pos_cur, const Position& pos_prev)
     {
-        update(acc_prev, pos_cur, pos_prev, WHITE);
-        update(acc_prev, pos_cur, pos_prev, BLACK);
+        apply(acc_prev, WHITE, DirtyFeatures::between(pos_cur, pos_prev, WHITE));
+        apply(acc_prev, BLACK, DirtyFeatures::between(pos_cur, pos_prev, BLACK));
     }
 
-    template <size_t UNROLL = 4>
-    [[nodiscard]] int32_t evaluate(const Color view) const
+    // prev is not read when the perspective is refreshed
+    void apply(const Accumulator& prev, const Color view, const DirtyFeatures& dirty)
     {
-        const auto our_acc_ptr = static_cast<const int16_t*>(
-            HWY_ASSUME_ALIGNED(view == WHITE ? white_accumulator.data() : black_accumulator.data(), 64));
-        const auto their_acc_ptr = static_cast<const int16_t*>(
-            HWY_ASSUME_ALIGNED(view == WHITE ? black_accumulator.data() : white_accumulator.data(), 64));
-
-        using D32 = ScalableTag<int32_t>;
-        using D16 = ScalableTag<int16_t>;
-
-        using HalfD16 = FixedTag<int16_t, Lanes(D32{})>;
-        using HalfD8  = FixedTag<int8_t, Lanes(D16{})>;
-
-
-        HWY_ALIGN std::array<int32_t, L1Sz> l1_out{};
-        std::memcpy(l1_out.data(), g_l1_biases, sizeof(g_l1_biases));
-        HWY_ALIGN std::array<int32_t, L2Sz> l2_out{};
-        std::memcpy(l2_out.data(), g_l2_biases, sizeof(g_l2_biases));
-        HWY_ALIGN int32_t out = g_out_bias[0];
-
-        // std::ranges::for_each(white_accumulator | std::views::take(10), [] (int16_t i) { std::cout << i << std::endl;
-        // });
-
-
-        for (size_t j = 0; j < OutSz; j += Lanes(D16{}) * UNROLL) {
-            std::array<Vec<D16>, UNROLL> v_our_block{};
-            std::array<Vec<D16>, UNROLL> v_their_block{};
-            for (size_t u = 0; u < UNROLL; ++u) {
-                const size_t idx = j + u * Lanes(HalfD8{});
-                v_our_block[u]   = Min(Max(Load(D16{}, &our_acc_ptr[idx]), Zero(D16{})), Set(D16{}, 127*32));
-                v_their_block[u] = Min(Max(Load(D16{}, &their_acc_ptr[idx]), Zero(D16{})), Set(D16{}, 127*32));
-            }
+        if (dirty.refresh)
+            refresh_acc(view, dirty.add);
+        else
+            update_acc(prev, view, dirty.add, dirty.rem);
+    }
 
+    // same as apply, but a refresh starts from the last accumulator cached for the new king bucket
+    void apply(const Accumulator& prev, const Color view, const DirtyFeatures& dirty, FinnyTable& finny);
 
-            for (int i = 0; i < L1Sz; ++i) {
-                Vec<D32> acc = Zero(D32{});
+    [[nodiscard]] int32_t evaluate(const Color view) const
+    {
+        const size_t bucket = output_bucket(pieces);
+        return view == WHITE ? nnue_kernels::evaluate(white_accumulator.data(), black_accumulator.data(), bucket)
+                             : nnue_kernels::evaluate(black_accumulator.data(), white_accumulator.data(), bucket);
+    }
 
-                for (size_t u = 0; u < UNROLL; ++u) {
-                    const size_t idx = j + u * Lanes(D16{});
-                    const Vec<D16> w_our   = Load(D16{}, &g_l1_weights[i * OutSz * 2 + idx]);
-                    const Vec<D16> w_their = Load(D16{}, &g_l1_weights[i * OutSz * 2 + idx + OutSz]);
+    // static evaluation of independent positions, each for its side to move, out must be as long as positions
+    // every accumulator is a full refresh, this is for analysis and labelling rather than search
+    // positions wait in one batch per output bucket, so a batch always shares its l1 weights
+    static void evaluate_batch(const std::span<const Position> positions, const std::span<int32_t> out)
+    {
+        assert(out.size() >= positions.size());
 
-                    acc = Add(acc, WidenMulPairwiseAdd(D32{}, v_our_block[u], w_our));
-                    acc = Add(acc, WidenMulPairwiseAdd(D32{}, v_their_block[u], w_their));
-                }
+        struct Batch
+        {
+            std::array<Accumulator, nnue_kernels::BATCH_SIZE>    accs;
+            std::array<const int16_t*, nnue_kernels::BATCH_SIZE> us{};
+            std::array<const int16_t*, nnue_kernels::BATCH_SIZE> them{};
+            std::array<size_t, nnue_kernels::BATCH_SIZE>         index{};
+            size_t                                               size = 0;
+        };
+        const auto batches = std::make_unique<std::array<Batch, N_OUTPUT_BUCKETS>>();
 
-                l1_out[i] += ReduceSum(D32{}, acc);
-            }
-        }
+        const auto flush = [&out](Batch& batch, const size_t bucket)
+        {
+            std::array<int32_t, nnue_kernels::BATCH_SIZE> evals{};
+            nnue_kernels::evaluate_batch(batch.us.data(), batch.them.data(), batch.size, bucket, evals.data());
+            for (size_t p = 0; p < batch.size; ++p)
+                out[batch.index[p]] = evals[p];
+            batch.size = 0;
+        };
 
-        // we get better precision by dividing in the end
-        using QuantVec = CappedTag<int32_t, L1Sz>;
-        for (int i = 0; i < L1Sz; i += Lanes(QuantVec{}))
+        for (size_t i = 0; i < positions.size(); ++i)
         {
-            Vec<D32> acc = Load(QuantVec{}, &l1_out[i]);
-            acc = ShiftRight<16>(acc);
-            Store(acc, QuantVec{}, &l1_out[i]);
+            const Position& pos   = positions[i];
+            const bool      white = pos.side_to_move() == WHITE;
+            const size_t    b     = output_bucket(pos.occupancy().popcount());
+            Batch&          batch = (*batches)[b];
+            Accumulator&    acc   = batch.accs[batch.size];
+
+            acc                       = Accumulator{pos};
+            batch.us[batch.size]      = (white ? acc.white_accumulator : acc.black_accumulator).data();
+            batch.them[batch.size]    = (white ? acc.black_accumulator : acc.white_accumulator).data();
+            batch.index[batch.size++] = i;
+            if (batch.size == nnue_kernels::BATCH_SIZE)
+                flush(batch, b);
         }
+        for (size_t b = 0; b < N_OUTPUT_BUCKETS; ++b)
+            if ((*batches)[b].size)
+                flush((*batches)[b], b);
+    }
+
+    // plain scalar version of the same quantised layers, the SIMD kernels must match it bit for bit
+    [[nodiscard]] int32_t evaluate_reference(const Color view) const
+    {
+        const auto& us   = view == WHITE ? white_accumulator : black_accumulator;
+        const auto& them = view == WHITE ? black_accumulator : white_accumulator;
 
+        const auto clipped = [&](const size_t j)
+        { return std::clamp<int>(j < OutSz ? us[j] : them[j - OutSz], 0, 127 * 32); };
 
-        // std::ranges::for_each(l1_out | std::views::take(10), [] (int16_t i) { std::cout << i << std::endl; });
+        const NetworkHead head = g_net.head(output_bucket(pieces));
 
-        for (int i = 0; i < L2Sz; ++i)
+        std::array<int32_t, L1Sz> l1_out{};
+        for (size_t i = 0; i < L1Sz; ++i)
         {
-            HWY_ALIGN Vec<D32> acc = Zero(D32{});
-            for (size_t j = 0; j < L1Sz; j += Lanes(HalfD16{}))
-            {
-                const Vec<D32> v = Max(Load(D32{}, &l1_out[j]), Zero(D32{}));
-                const Vec<D32> w = PromoteTo(D32{}, Load(HalfD16{}, &g_l2_weights[i * L1Sz + j]));
-                acc = Add(acc, Mul(v, w));
-            }
-            l2_out[i] += ReduceSum(D32{}, acc);
+            int32_t sum = head.l1_biases[i];
+            for (size_t j = 0; j < 2 * OutSz; ++j)
+                sum += clipped(j) * head.l1_weights[i * 2 * OutSz + j];
+            l1_out[i] = sum >> 16;
         }
 
-
-        HWY_ALIGN Vec<D32> acc = Zero(D32{});
-        for (size_t j = 0; j < L2Sz; j += Lanes(HalfD16{}))
+        int32_t out = head.out_bias;
+        for (size_t i = 0; i < L2Sz; ++i)
         {
-            const Vec<D32> v = Max(Load(D32{}, &l2_out[j]), Zero(D32{}));
-            const Vec<D32> w = PromoteTo(D32{}, Load(HalfD16{}, &g_out_weights[j]));
-            acc = Add(acc, Mul(v, w));
+            int32_t sum = head.l2_biases[i];
+            for (size_t j = 0; j < L1Sz; ++j)
+                sum += std::max(l1_out[j], 0) * head.l2_weights[j * L2Sz + i];
+            out += std::max(sum, 0) * head.out_weights[i];
         }
-        out += ReduceSum(D32{}, acc);
-
         return out >> 16;
     }
 
   private:
-    void update(const Accumulator& prev, const Position& pos_cur, const Position& pos_prev, const Color view)
-    {
-        const bool needs_refresh = FeatureTransformer::needs_refresh(pos_cur, pos_prev, view);
-        const auto [add, rem]    = FeatureTransformer::get_features(pos_cur, pos_prev, view, needs_refresh);
-        if (needs_refresh)
-            refresh_acc(view, add);
-        else
-            update_acc(prev, view, add, rem);
-    }
-
-    template <size_t UNROLL = 8>
     void refresh_acc(const Color view, const FeatureTransformer::RetT& features)
     {
         auto& acc = (view == WHITE ? white_accumulator : black_accumulator);
-
-        std::memcpy(acc.data(), g_ft_biases, OutSz * sizeof(int16_t));
-
-        using D                         = ScalableTag<int16_t>;
-        alignas(64) auto v_accumulators = std::array<decltype(Load(D{}, acc.data())), UNROLL>{};
-
-        auto* HWY_RESTRICT acc_ptr = static_cast<int16_t*>(HWY_ASSUME_ALIGNED(acc.data(), 64));
-
-        for (size_t i = 0; i < OutSz; i += UNROLL * Lanes(D{}))
-        {
-            for (size_t u = 0; u < UNROLL; ++u)
-            {
-                if (i + u * Lanes(D{}) < OutSz)
-                    v_accumulators[u] = Load(D{}, &acc_ptr[i + u * Lanes(D{})]);
-            }
-
-            for (const auto f : features)
-            {
-                for (size_t u = 0; u < UNROLL; ++u)
-                {
-                    if (i + u * Lanes(D{}) < OutSz)
-                    {
-                        auto v_weights    = Load(D{}, &g_ft_weights[f * OutSz + i + u * Lanes(D{})]);
-                        v_accumulators[u] = Add(v_accumulators[u], v_weights);
-                    }
-                }
-            }
-
-            for (size_t u = 0; u < UNROLL; ++u)
-            {
-                if (i + u * Lanes(D{}) < OutSz)
-                    Store(v_accumulators[u], D{}, &acc_ptr[i + u * Lanes(D{})]);
-            }
-        }
+        add_sub(acc.data(), g_net.ft_biases, features, FeatureTransformer::RetT{});
+        pieces = static_cast<int>(features.size());
     }
 
-    template <size_t UNROLL = 8>
     void update_acc(const Accumulator& previous, const Color view, const FeatureTransformer::RetT& add,
                     const FeatureTransformer::RetT& sub)
     {
         auto& acc  = (view == WHITE ? white_accumulator : black_accumulator);
         auto& prev = (view == WHITE ? previous.white_accumulator : previous.black_accumulator);
 
-        std::memcpy(acc.data(), prev.data(), OutSz * sizeof(int16_t));
+        // quiet moves and promotions, captures and en passant, castling
+        const size_t n_add = add.size();
+        const size_t n_sub = sub.size();
+        pieces             = previous.pieces + static_cast<int>(n_add) - static_cast<int>(n_sub);
+        if (n_add == 1 && n_sub == 1)
+            add_sub<1, 1>(acc.data(), prev.data(), add.data(), sub.data());
+        else if (n_add == 1 && n_sub == 2)
+            add_sub<1, 2>(acc.data(), prev.data(), add.data(), sub.data());
+        else if (n_add == 2 && n_sub == 2)
+            add_sub<2, 2>(acc.data(), prev.data(), add.data(), sub.data());
+        else
+            add_sub(acc.data(), prev.data(), add, sub);
+    }
 
-        using D                         = ScalableTag<int16_t>;
-        alignas(64) auto v_accumulators = std::array<decltype(Load(D{}, acc.data())), UNROLL>{};
+  public:
+    // the kernels are public so they can be benchmarked on their own
 
-        auto* HWY_RESTRICT acc_ptr = static_cast<int16_t*>(HWY_ASSUME_ALIGNED(acc.data(), 64));
+    // fixed change counts: the weight rows are resolved once and every lane goes src -> dst in registers
+    template <size_t N_ADD, size_t N_SUB>
+    static void add_sub(int16_t* dst, const int16_t* src, const FeatureTransformer::FeatureT* add,
+                        const FeatureTransformer::FeatureT* sub)
+    {
+        if constexpr (N_ADD == 1 && N_SUB == 1)
+            nnue_kernels::add_sub_1_1(dst, src, add, sub);
+        else if constexpr (N_ADD == 1 && N_SUB == 2)
+            nnue_kernels::add_sub_1_2(dst, src, add, sub);
+        else if constexpr (N_ADD == 2 && N_SUB == 2)
+            nnue_kernels::add_sub_2_2(dst, src, add, sub);
+        else
+            nnue_kernels::add_sub(dst, src, add, N_ADD, sub, N_SUB);
+    }
 
-        for (size_t i = 0; i < OutSz; i += UNROLL * Lanes(D{}))
-        {
-            for (size_t u = 0; u < UNROLL; ++u)
-            {
-                if (i + u * Lanes(D{}) < OutSz)
-                    v_accumulators[u] = Load(D{}, &acc_ptr[i + u * Lanes(D{})]);
-            }
+    // dst = src + add - sub, one pass over the accumulator, dst may be src
+    template <typename AddT, typename SubT>
+    static void add_sub(int16_t* dst, const int16_t* src, const AddT& add, const SubT& sub)
+    {
+        nnue_kernels::add_sub(dst, src, add.data(), add.size(), sub.data(), sub.size());
+    }
 
-            for (const auto f : add)
-            {
-                for (size_t u = 0; u < UNROLL; ++u)
-                {
-                    if (i + u * Lanes(D{}) < OutSz)
-                    {
-                        auto v_weights    = Load(D{}, &g_ft_weights[f * OutSz + i + u * Lanes(D{})]);
-                        v_accumulators[u] = Add(v_accumulators[u], v_weights);
-                    }
-                }
-            }
+  private:
+    friend struct FinnyTable;
+};
 
-            for (const auto f : sub)
-            {
-                for (size_t u = 0; u < UNROLL; ++u)
-                {
-                    if (i + u * Lanes(D{}) < OutSz)
-                    {
-                        auto v_weights    = Load(D{}, &g_ft_weights[f * OutSz + i + u * Lanes(D{})]);
-                        v_accumulators[u] = Sub(v_accumulators[u], v_weights);
-                    }
-                }
-            }
+// per thread cache of the last accumulator seen in each king bucket, with the board it was computed for
+// a king crossing into a bucket only applies the pieces that changed since the cache was last used there
+// this is the board kept as its feature set: within a bucket a feature is exactly one (piece, square)
+struct FinnyTable
+{
+    using FeatureSet = ArrayStack<FeatureTransformer::FeatureT, FeatureTransformer::MaxChanges>;
 
-            for (size_t u = 0; u < UNROLL; ++u)
-            {
-                if (i + u * Lanes(D{}) < OutSz)
-                    Store(v_accumulators[u], D{}, &acc_ptr[i + u * Lanes(D{})]);
-            }
+    FinnyTable()
+    {
+        for (auto& view : m_entries)
+            for (auto& e : view)
+                std::memcpy(e.acc.data(), g_net.ft_biases, sizeof(e.acc));
+    }
+
+    void refresh(Accumulator& acc, const Color view, const DirtyFeatures& dirty)
+    {
+        assert(dirty.refresh);
+        Entry& e = m_entries[view][dirty.bucket];
+
+        FeatureSet cur = dirty.add;
+        std::sort(cur.begin(), cur.end());
+
+        // both sets are sorted, one merge gives what was added and what was removed
+        FeatureSet add;
+        FeatureSet rem;
+        auto       a = e.features.begin();
+        auto       b = cur.begin();
+        while (a != e.features.end() || b != cur.end())
+        {
+            if (b == cur.end() || (a != e.features.end() && *a < *b))
+                rem.push_back(*a++);
+            else if (a == e.features.end() || *b < *a)
+                add.push_back(*b++);
+            else
+                ++a, ++b;
         }
+
+        auto& half = (view == WHITE ? acc.white_accumulator : acc.black_accumulator);
+        Accumulator::add_sub(e.acc.data(), e.acc.data(), add, rem);
+        std::memcpy(half.data(), e.acc.data(), sizeof(half));
+        acc.pieces = static_cast<int>(cur.size());
+        e.features = cur;
     }
-};
 
-HWY_AFTER_NAMESPACE();
+  private:
+    struct Entry
+    {
+        alignas(64) Accumulator::AccumulatorT acc{};
+        FeatureSet                            features{};
+    };
+
+    EnumArray<Color, std::array<Entry, FeatureTransformer::n_buckets_v>> m_entries{};
+};
 
+inline void Accumulator::apply(const Accumulator& prev, const Color view, const DirtyFeatures& dirty, FinnyTable& finny)
+{
+    if (dirty.refresh)
+        finny.refresh(*this, view, dirty);
+    else
+        update_acc(prev, view, dirty.add, dirty.rem);
+}
+
+// moves only record their dirty features, an accumulator is computed when its node is evaluated
+// many nodes never are (tt cutoffs, repetitions, pruning), they cost a feature diff instead of a 4KB update
+// one slot per ply, allocated once: pushing never grows or moves anything, every accumulator stays 64 byte aligned
+// a null move pushes nothing, the board is unchanged so the node keeps reading its parent's slot
 struct Accumulators
 {
-    using Acc         = Accumulator;
-    using ConstAcc    = const Acc;
-    using AccRef      = Acc&;
-    using ConstAccRef = ConstAcc&;
+    static constexpr size_t Capacity = MAX_PLY + 1;
 
     explicit Accumulators(const Position& pos)
     {
-        m_accumulators.reserve(MAX_PLY);
-        m_accumulators.emplace_back(pos);
+        m_stack[0].acc      = Accumulator{pos};
+        m_stack[0].computed = {true, true};
+        m_size              = 1;
     }
 
-    std::span<Acc>                    accumulators() { return m_accumulators; }
-    [[nodiscard]] std::span<ConstAcc> accumulators() const { return m_accumulators; }
+    [[nodiscard]] size_t size() const { return m_size; }
 
-    AccRef                    last() { return m_accumulators.back(); }
-    [[nodiscard]] ConstAccRef last() const { return m_accumulators.back(); }
+    Accumulator& last()
+    {
+        materialize(WHITE);
+        materialize(BLACK);
+        return m_stack[m_size - 1].acc;
+    }
 
     void do_move(const Position& prev, const Position& next)
     {
-        m_accumulators.emplace_back(m_accumulators.back(), next, prev);
+        assert(m_size < Capacity);
+        Entry& e = m_stack[m_size++];
+        for (const auto view : {WHITE, BLACK})
+        {
+            e.dirty[view]    = DirtyFeatures::between(next, prev, view);
+            e.computed[view] = false;
+        }
     }
 
-    void undo_move() { m_accumulators.pop_back(); }
+    void undo_move()
+    {
+        assert(m_size > 1);
+        --m_size;
+    }
 
   private:
-    std::vector<Accumulator> m_accumulators{};
+    struct alignas(64) Entry
+    {
+        Accumulator                     acc{};
+        EnumArray<Color, DirtyFeatures> dirty{};
+        EnumArray<Color, bool>          computed{};
+    };
+
+    // walk back to the closest computed or refreshed ancestor then replay the deltas up to the top
+    // the root is always computed so the walk stops
+    void materialize(const Color view)
+    {
+        size_t first = m_size - 1;
+        while (!m_stack[first].computed[view] && !m_stack[first].dirty[view].refresh)
+            --first;
+        if (m_stack[first].computed[view])
+            ++first;
+        for (size_t i = first; i < m_size; ++i)
+        {
+            m_stack[i].acc.apply(m_stack[i - 1].acc, view, m_stack[i].dirty[view], *m_finny);
+            m_stack[i].computed[view] = true;
+        }
+    }
+
+    // on the heap, a search thread is too big for the stack with it inline
+    std::unique_ptr<Entry[]>    m_stack = std::make_unique<Entry[]>(Capacity);
+    size_t                      m_size  = 0;
+    std::unique_ptr<FinnyTable> m_finny = std::make_unique<FinnyTable>();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,258 @@
+//
+// Created by paul on 10/16/26.
+//
+
+// the SIMD side of the evaluation, included once per target by nnue_kernels.cpp through foreach_target.h
+// everything in here is compiled for each instruction set Highway generates, the best one is picked at startup
+
+// per target include guard, toggled by foreach_target.h
+#if defined(CHEPP_NNUE_KERNELS_INL_H) == defined(HWY_TARGET_TOGGLE)
+#ifdef CHEPP_NNUE_KERNELS_INL_H
+#undef CHEPP_NNUE_KERNELS_INL_H
+#else
+#define CHEPP_NNUE_KERNELS_INL_H
+#endif
+
+#include "ChePP/engine/nnue.h"
+
+#include <hwy/highway.h>
+
+HWY_BEFORE_NAMESPACE();
+namespace nnue_kernels::HWY_NAMESPACE
+{
+    using namespace hwy::HWY_NAMESPACE;
+
+    using FeatureT = FeatureTransformer::FeatureT;
+
+    constexpr size_t OutSz = Accumulator::OutSz;
+    constexpr size_t L1Sz  = Accumulator::L1Sz;
+    constexpr size_t L2Sz  = Accumulator::L2Sz;
+
+    // fixed change counts: the weight rows are resolved once and every lane goes src -> dst in registers
+    template <size_t N_ADD, size_t N_SUB>
+    HWY_INLINE void add_sub_fixed(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub)
+    {
+        using D = ScalableTag<int16_t>;
+
+        std::array<const int16_t*, N_ADD> add_rows{};
+        std::array<const int16_t*, N_SUB> sub_rows{};
+        for (size_t k = 0; k < N_ADD; ++k)
+            add_rows[k] = &g_net.ft_weights[add[k] * OutSz];
+        for (size_t k = 0; k < N_SUB; ++k)
+            sub_rows[k] = &g_net.ft_weights[sub[k] * OutSz];
+
+        auto*       dst_ptr = static_cast<int16_t*>(HWY_ASSUME_ALIGNED(dst, 64));
+        const auto* src_ptr = static_cast<const int16_t*>(HWY_ASSUME_ALIGNED(src, 64));
+
+        for (size_t i = 0; i < OutSz; i += Lanes(D{}))
+        {
+            auto v = Load(D{}, &src_ptr[i]);
+            for (size_t k = 0; k < N_ADD; ++k)
+                v = Add(v, Load(D{}, &add_rows[k][i]));
+            for (size_t k = 0; k < N_SUB; ++k)
+                v = Sub(v, Load(D{}, &sub_rows[k][i]));
+            Store(v, D{}, &dst_ptr[i]);
+        }
+    }
+
+    // quiet moves and promotions, captures and en passant, castling
+    void add_sub_1_1(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub)
+    {
+        add_sub_fixed<1, 1>(dst, src, add, sub);
+    }
+
+    void add_sub_1_2(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub)
+    {
+        add_sub_fixed<1, 2>(dst, src, add, sub);
+    }
+
+    void add_sub_2_2(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub)
+    {
+        add_sub_fixed<2, 2>(dst, src, add, sub);
+    }
+
+    // dst = src + add - sub, one pass over the accumulator, dst may be src
+    void add_sub(int16_t* dst, const int16_t* src, const FeatureT* add, const size_t n_add, const FeatureT* sub,
+                 const size_t n_sub)
+    {
+        constexpr size_t UNROLL = 8;
+
+        using D                         = ScalableTag<int16_t>;
+        alignas(64) auto v_accumulators = std::array<decltype(Load(D{}, src)), UNROLL>{};
+
+        auto*       dst_ptr = static_cast<int16_t*>(HWY_ASSUME_ALIGNED(dst, 64));
+        const auto* src_ptr = static_cast<const int16_t*>(HWY_ASSUME_ALIGNED(src, 64));
+
+        for (size_t i = 0; i < OutSz; i += UNROLL * Lanes(D{}))
+        {
+            for (size_t u = 0; u < UNROLL; ++u)
+            {
+                if (i + u * Lanes(D{}) < OutSz)
+                    v_accumulators[u] = Load(D{}, &src_ptr[i + u * Lanes(D{})]);
+            }
+
+            for (size_t k = 0; k < n_add; ++k)
+            {
+                for (size_t u = 0; u < UNROLL; ++u)
+                {
+                    if (i + u * Lanes(D{}) < OutSz)
+                    {
+                        auto v_weights    = Load(D{}, &g_net.ft_weights[add[k] * OutSz + i + u * Lanes(D{})]);
+                        v_accumulators[u] = Add(v_accumulators[u], v_weights);
+                    }
+                }
+            }
+
+            for (size_t k = 0; k < n_sub; ++k)
+            {
+                for (size_t u = 0; u < UNROLL; ++u)
+                {
+                    if (i + u * Lanes(D{}) < OutSz)
+                    {
+                        auto v_weights    = Load(D{}, &g_net.ft_weights[sub[k] * OutSz + i + u * Lanes(D{})]);
+                        v_accumulators[u] = Sub(v_accumulators[u], v_weights);
+                    }
+                }
+            }
+
+            for (size_t u = 0; u < UNROLL; ++u)
+            {
+                if (i + u * Lanes(D{}) < OutSz)
+                    Store(v_accumulators[u], D{}, &dst_ptr[i + u * Lanes(D{})]);
+            }
+        }
+    }
+
+    // clips the accumulator to [0, 127 * 32], l1 multiplies it as is with the int16 weights of the net
+    HWY_INLINE void pack_activations(const int16_t* acc, int16_t* out)
+    {
+        using D16 = ScalableTag<int16_t>;
+
+        const auto* acc_ptr = static_cast<const int16_t*>(HWY_ASSUME_ALIGNED(acc, 64));
+        for (size_t j = 0; j < OutSz; j += Lanes(D16{}))
+            Store(Min(Max(Load(D16{}, &acc_ptr[j]), Zero(D16{})), Set(D16{}, 127 * 32)), D16{}, &out[j]);
+    }
+
+    // one horizontal sum per output, N positions laid out back to back in act share each weight load
+    template <size_t N>
+    HWY_INLINE void l1_layer(const NetworkHead& head, const int16_t* act, int32_t* out)
+    {
+        using D16 = ScalableTag<int16_t>;
+        using D32 = Repartition<int32_t, D16>;
+
+        for (size_t i = 0; i < L1Sz; ++i)
+        {
+            const int16_t* w = &head.l1_weights[i * 2 * OutSz];
+
+            std::array<Vec<D32>, N> acc;
+            for (auto& a : acc)
+                a = Zero(D32{});
+
+            for (size_t j = 0; j < 2 * OutSz; j += Lanes(D16{}))
+            {
+                const auto v_w = Load(D16{}, &w[j]);
+                for (size_t p = 0; p < N; ++p)
+                    acc[p] = Add(acc[p], WidenMulPairwiseAdd(D32{}, Load(D16{}, &act[p * 2 * OutSz + j]), v_w));
+            }
+
+            // we get better precision by dividing in the end
+            for (size_t p = 0; p < N; ++p)
+                out[p * L1Sz + i] = (head.l1_biases[i] + ReduceSum(D32{}, acc[p])) >> 16;
+        }
+    }
+
+    // relu on the l1 outputs, zero inputs are skipped
+    HWY_INLINE void l2_affine(const NetworkHead& head, const int32_t* in, int32_t* out)
+    {
+        using D32 = CappedTag<int32_t, L2Sz>;
+
+        constexpr size_t N_ACC = L2Sz / Lanes(D32{});
+        std::array<Vec<D32>, N_ACC> acc;
+        for (size_t b = 0; b < N_ACC; ++b)
+            acc[b] = LoadU(D32{}, &head.l2_biases[b * Lanes(D32{})]);
+
+        for (size_t j = 0; j < L1Sz; ++j)
+        {
+            if (in[j] <= 0)
+                continue;
+            const auto     x = Set(D32{}, in[j]);
+            const int32_t* w = &head.l2_weights[j * L2Sz];
+            for (size_t b = 0; b < N_ACC; ++b)
+                acc[b] = Add(acc[b], Mul(x, Load(D32{}, &w[b * Lanes(D32{})])));
+        }
+
+        for (size_t b = 0; b < N_ACC; ++b)
+            Store(acc[b], D32{}, &out[b * Lanes(D32{})]);
+    }
+
+    HWY_INLINE int32_t output(const NetworkHead& head, const int32_t* l2_out)
+    {
+        using D32     = ScalableTag<int32_t>;
+        using HalfD16 = FixedTag<int16_t, Lanes(D32{})>;
+
+        int32_t out = head.out_bias;
+
+        auto acc = Zero(D32{});
+        for (size_t j = 0; j < L2Sz; j += Lanes(HalfD16{}))
+        {
+            const auto v = Max(Load(D32{}, &l2_out[j]), Zero(D32{}));
+            const auto w = PromoteTo(D32{}, Load(HalfD16{}, &head.out_weights[j]));
+            acc          = Add(acc, Mul(v, w));
+        }
+        out += ReduceSum(D32{}, acc);
+
+        return out >> 16;
+    }
+
+    // us is the accumulator of the side the evaluation is for
+    // the bucket is resolved first, the layers only ever read the weights of that one
+    int32_t evaluate(const int16_t* us, const int16_t* them, const size_t bucket)
+    {
+        const NetworkHead head = g_net.head(bucket);
+
+        HWY_ALIGN std::array<int16_t, 2 * OutSz> act;
+        pack_activations(us, act.data());
+        pack_activations(them, act.data() + OutSz);
+
+        HWY_ALIGN std::array<int32_t, L1Sz> l1_out{};
+        l1_layer<1>(head, act.data(), l1_out.data());
+
+        HWY_ALIGN std::array<int32_t, L2Sz> l2_out{};
+        l2_affine(head, l1_out.data(), l2_out.data());
+
+        return output(head, l2_out.data());
+    }
+
+    // same as evaluate for up to BATCH_SIZE positions of the same bucket
+    // l1 loads each of its weights once per batch instead of once per position
+    // the missing positions of a short batch are zero activations, they only cost their multiplies
+    void evaluate_batch(const int16_t* const* us, const int16_t* const* them, const size_t n, const size_t bucket,
+                        int32_t* out)
+    {
+        const NetworkHead head = g_net.head(bucket);
+
+        HWY_ALIGN std::array<int16_t, BATCH_SIZE * 2 * OutSz> act{};
+        for (size_t p = 0; p < n; ++p)
+        {
+            pack_activations(us[p], &act[p * 2 * OutSz]);
+            pack_activations(them[p], &act[p * 2 * OutSz + OutSz]);
+        }
+
+        HWY_ALIGN std::array<int32_t, BATCH_SIZE * L1Sz> l1_out{};
+        l1_layer<BATCH_SIZE>(head, act.data(), l1_out.data());
+
+        for (size_t p = 0; p < n; ++p)
+        {
+            HWY_ALIGN std::array<int32_t, L2Sz> l2_out{};
+            l2_affine(head, &l1_out[p * L1Sz], l2_out.data());
+            out[p] = output(head, l2_out.data());
+        }
+    }
+
+    // lets the dispatcher report what it picked
+    int64_t target() { return HWY_TARGET; }
+
+} // namespace nnue_kernels::HWY_NAMESPACE
+HWY_AFTER_NAMESPACE();
+
+#endif // CHEPP_NNUE_KERNELS_INL_H
@@ -42,6 +42,8 @@ struct Position
     [[nodiscard]] Bitboard checkers(const Color c) const { return m_check_mask.at(c) & occupancy(~c); }
     [[nodiscard]] Bitboard blockers(const Color c) const { return m_blockers.at(c); }
     [[nodiscard]] Bitboard check_mask(const Color c) const { return m_check_mask.at(c); }
+    // squares from which a piece of that type of the side to move would attack the enemy king
+    [[nodiscard]] Bitboard check_squares(const PieceType pt) const { return m_check_squares.at(pt); }
 
 
     [[nodiscard]] Bitboard occupancy() const { return m_global_occupancy; }
@@ -62,15 +64,20 @@ struct Position
     [[nodiscard]] bool     is_attacking_sq(Square sq, Color c) const;
 
 
+    template <Color c>
+    [[nodiscard]] bool is_pseudo_legal(Move move) const;
+    [[nodiscard]] bool is_pseudo_legal(Move move) const;
     template <Color c>
     [[nodiscard]] bool is_legal(Move move) const;
     [[nodiscard]] bool is_legal(Move move) const;
     void               do_move(Move move);
+    [[nodiscard]] hash_t key_after(Move move) const;
 
 
     template <PieceType pt>
     void update_checkers_and_blockers(Color c);
     void update_checkers_and_blockers(Color c);
+    void update_check_squares();
     void update();
 
 
@@ -90,7 +97,8 @@ struct Position
     [[nodiscard]] unsigned dtz_probe() const;
 
 
-    [[nodiscard]] int see(Move move) const;
+    [[nodiscard]] int  see(Move move) const;
+    [[nodiscard]] bool see_ge(Move move, int threshold) const;
   private:
     // copied
     zobrist_t                      m_hash{};
@@ -110,8 +118,9 @@ struct Position
     // 5 available
 
     // recomputed
-    EnumArray<Color, Bitboard> m_blockers{};
-    EnumArray<Color, Bitboard> m_check_mask{};
+    EnumArray<Color, Bitboard>     m_blockers{};
+    EnumArray<Color, Bitboard>     m_check_mask{};
+    EnumArray<PieceType, Bitboard> m_check_squares{};
 };
 
 
@@ -236,6 +245,20 @@ inline void Position::update_checkers_and_blockers(const Color c)
     update_checkers_and_blockers<ROOK>(c);
 }
 
+inline void Position::update_check_squares()
+{
+    // same trick as attacking_sq, the squares are the attacks of each piece type from the enemy king
+    const Color  them = ~side_to_move();
+    const Square k    = ksq(them);
+
+    m_check_squares.at(PAWN)   = attacks<PAWN>(k, occupancy(), them);
+    m_check_squares.at(KNIGHT) = attacks<KNIGHT>(k, occupancy());
+    m_check_squares.at(BISHOP) = attacks<BISHOP>(k, occupancy());
+    m_check_squares.at(ROOK)   = attacks<ROOK>(k, occupancy());
+    m_check_squares.at(QUEEN)  = check_squares(BISHOP) | check_squares(ROOK);
+    m_check_squares.at(KING)   = bb::empty();
+}
+
 inline void Position::update()
 {
     m_global_occupancy = occupancy(WHITE) | occupancy(BLACK);
@@ -243,6 +266,7 @@ inline void Position::update()
 
     update_checkers_and_blockers(side_to_move());
     update_checkers_and_blockers(~side_to_move());
+    update_check_squares();
 }
 
 
@@ -431,6 +455,82 @@ inline std::string Position::to_string() const
 
 
 
+// whether gen_moves could have produced move here, is_legal still has to be checked after it
+// tt moves and killers come from other positions and must go through this before being played
+template <Color c>
+bool Position::is_pseudo_legal(const Move move) const
+{
+    constexpr Direction up = c == WHITE ? NORTH : SOUTH;
+
+    if (!move.is_ok())
+        return false;
+
+    const Square from = move.from_sq();
+    const Square to   = move.to_sq();
+    const Piece  pc   = piece_at(from);
+
+    if (pc == NO_PIECE || pc.color() != c)
+        return false;
+
+    if (move.type_of() == CASTLING)
+    {
+        // same conditions as gen_castling, the destination of the king is left to is_legal
+        const auto type     = move.castling_type();
+        auto [k_from, k_to] = type.king_move();
+        auto [r_from, r_to] = type.rook_move();
+        if (type.color() != c || !castling_rights().has(type) || from != k_from || to != k_to || check_mask(c))
+            return false;
+        if (from_to_excl(k_from, r_from) & occupancy())
+            return false;
+        const Direction dir = direction_from(k_from, k_to);
+        for (auto sq = k_from + dir; sq != k_to; sq = sq + dir)
+        {
+            if (is_attacking_sq(sq, ~c))
+                return false;
+        }
+        return true;
+    }
+
+    if (occupancy(c).is_set(to))
+        return false;
+
+    if (pc.type() == KING)
+        return move.type_of() == NORMAL && attacks<KING>(from, occupancy()).is_set(to);
+
+    // in double check only the king moves, otherwise the move has to capture the checker or block it
+    if (checkers(c).popcount() == 2)
+        return false;
+    const Bitboard target = check_mask(c) ? check_mask(c) : bb::full();
+
+    if (pc.type() != PAWN)
+        return move.type_of() == NORMAL && (attacks(pc.type(), from, occupancy()) & target).is_set(to);
+
+    if (move.type_of() == EN_PASSANT)
+        return to == ep_square() && pseudo_attack<PAWN>(from, c).is_set(to) &&
+               (target.is_set(to) || target.is_set(to - up));
+
+    // reaching the last rank has to promote and only reaching it can
+    if ((move.type_of() == PROMOTION) != Bitboard(relative_rank<c, RANK_8>).is_set(to))
+        return false;
+
+    const int  delta       = to.value() - from.value();
+    const bool push        = delta == up && !is_occupied(to);
+    const bool double_push = delta == 2 * up && Bitboard(relative_rank<c, RANK_2>).is_set(from) &&
+                             !is_occupied(from + up) && !is_occupied(to);
+    const bool capture     = pseudo_attack<PAWN>(from, c).is_set(to) && occupancy(~c).is_set(to);
+
+    return (push || double_push || capture) && target.is_set(to);
+}
+
+inline bool Position::is_pseudo_legal(const Move move) const
+{
+    if (side_to_move() == WHITE)
+        return is_pseudo_legal<WHITE>(move);
+    if (side_to_move() == BLACK)
+        return is_pseudo_legal<BLACK>(move);
+    return false;
+}
+
 template <Color c>
 bool Position::is_legal(const Move move) const
 {
@@ -597,6 +697,67 @@ inline void Position::do_move(const Move move)
 
 
 
+// the hash do_move would produce, without touching the board
+// lets the search prefetch the child tt cluster before paying for the move itself
+inline hash_t Position::key_after(const Move move) const
+{
+    zobrist_t key{m_hash};
+    key.flip_color();
+
+    if (ep_square() != NO_SQUARE)
+    {
+        key.flip_ep(ep_square().file());
+    }
+
+    if (move == Move::null())
+    {
+        return key.value();
+    }
+
+    const Square    from = move.from_sq();
+    const Square    to   = move.to_sq();
+    const Piece     pc   = piece_at(from);
+    const Color     us   = pc.color();
+    const Direction up   = us == WHITE ? NORTH : SOUTH;
+
+    key.flip_castling_rights(m_crs.lost_from_move(move).mask());
+
+    if (move.type_of() == CASTLING)
+    {
+        auto [k_from, k_to] = move.castling_type().king_move();
+        auto [r_from, r_to] = move.castling_type().rook_move();
+        key.move_piece(Piece{us, KING}, k_from, k_to);
+        key.move_piece(Piece{us, ROOK}, r_from, r_to);
+        return key.value();
+    }
+
+    if (move.type_of() == EN_PASSANT)
+    {
+        key.flip_piece(Piece{~us, PAWN}, to - up);
+    }
+    else if (is_occupied(to))
+    {
+        key.flip_piece(piece_at(to), to);
+    }
+    else if (pc.type() == PAWN && to.value() - from.value() == 2 * up &&
+             ((pseudo_attack<PAWN>(to - up, us)) & occupancy(~us)) != bb::empty())
+    {
+        key.flip_ep(from.file());
+    }
+
+    if (move.type_of() == PROMOTION)
+    {
+        key.flip_piece(pc, from);
+        key.flip_piece(Piece{us, move.promotion_type()}, to);
+    }
+    else
+    {
+        key.move_piece(pc, from, to);
+    }
+
+    return key.value();
+}
+
 inline unsigned Position::wdl_probe() const
 {
     size_t ep_sq = ep_square() == NO_SQUARE ? 0 : ep_square().index() + 1;
@@ -633,8 +794,9 @@ inline int Position::see(const Move move) const
     const Direction up    = (us == WHITE) ? NORTH : SOUTH;
     const bool      is_ep = move.type_of() == EN_PASSANT;
 
-    std::vector<int> gains;
-    gains.reserve(32);
+    // one entry per capture, there are at most 32 pieces to trade
+    std::array<int, 32> gains{};
+    int                 n_gains = 0;
 
     Bitboard occ = occupancy();
     occ.unset(is_ep ? to - up : to);
@@ -658,7 +820,7 @@ inline int Position::see(const Move move) const
     const Piece captured = piece_at(is_ep ? to - up : to);
 
     capture(from);
-    gains.push_back(captured ? captured.piece_value() : 0);
+    gains[n_gains++] = captured ? captured.piece_value() : 0;
     int balance = captured ? captured.piece_value() : 0;
 
     Color     side             = them;
@@ -695,15 +857,83 @@ inline int Position::see(const Move move) const
         side = ~side;
 
         balance = -balance + cur.piece_value();
-        gains.push_back(balance);
+        gains[n_gains++] = balance;
 
         cur = chosen_pt;
     }
 
-    for (int i = static_cast<int>(gains.size()) - 1; i > 0; --i)
+    for (int i = n_gains - 1; i > 0; --i)
         gains[i - 1] = std::min(-gains[i], gains[i - 1]);
 
-    return gains.empty() ? 0 : gains[0];
+    return gains[0];
+}
+
+// whether see(move) >= threshold, same exchange model without building the list of gains
+// swap is how far the side to recapture has to get back to flip the verdict, the loop stops as soon as it can not
+inline bool Position::see_ge(const Move move, const int threshold) const
+{
+    assert(move.type_of() != CASTLING);
+
+    const Square    from  = move.from_sq();
+    const Square    to    = move.to_sq();
+    const Color     us    = color_at(from);
+    const Direction up    = (us == WHITE) ? NORTH : SOUTH;
+    const Square    capsq = move.type_of() == EN_PASSANT ? to - up : to;
+
+    int swap = (is_occupied(capsq) ? piece_at(capsq).piece_value() : 0) - threshold;
+    if (swap < 0)
+        return false;
+
+    swap = piece_at(from).piece_value() - swap;
+    if (swap <= 0)
+        return true;
+
+    Bitboard occ = occupancy();
+    occ.unset(from);
+    occ.unset(capsq);
+
+    Bitboard attackers = attacking_sq(to, occ);
+    if (attackers.is_set(ksq(WHITE)) && attackers.is_set(ksq(BLACK)))
+    {
+        attackers.unset(ksq(WHITE));
+        attackers.unset(ksq(BLACK));
+    }
+
+    Color side = us;
+    int   res  = 1;
+    while (true)
+    {
+        side = ~side;
+        attackers &= occ;
+
+        const Bitboard attacking = attackers & occupancy(side);
+        if (!attacking)
+            break;
+
+        res ^= 1;
+
+        // the least valuable attacker recaptures
+        PieceType pt = PAWN;
+        Bitboard  bb = occupancy(side, pt) & attacking;
+        while (!bb)
+        {
+            pt = pt + 1;
+            bb = occupancy(side, pt) & attacking;
+        }
+
+        // the king only takes when nothing can take it back
+        if (pt == KING)
+            return (attackers & occupancy(~side)) ? !res : res;
+
+        swap = pt.piece_value() - swap;
+        if (swap < res)
+            break;
+
+        occ.unset(Square{bb.get_lsb()});
+        attackers |= (attacks<ROOK>(to, occ) & occupancy(ROOK, QUEEN)) |
+                     (attacks<BISHOP>(to, occ) & occupancy(BISHOP, QUEEN));
+    }
+    return res;
 }
 
 struct Positions
@@ -62,9 +62,13 @@ struct SearchThread
 
     [[nodiscard]] std::size_t ply() const { return m_positions.ply(); }
 
+    // null moves pass false: the board does not change so the node keeps using its parent's accumulator slot
     template <bool UpdateNNUE = true>
     void do_move(const Move move)
     {
+        // the child probes the tt first thing, start loading its cluster now
+        // so the miss overlaps with the board and accumulator updates
+        g_tt.prefetch(m_positions.last().key_after(move));
         m_positions.do_move(move);
         if constexpr (UpdateNNUE) m_accumulators.do_move(m_positions[ply() - 1], m_positions.last());
     }
@@ -76,14 +80,28 @@ struct SearchThread
         if constexpr (UpdateNNUE) m_accumulators.undo_move();
     }
 
-    int32_t evaluate()
+    // network output only, this is what the tt keeps so a hit can skip the accumulator
+    int32_t raw_evaluate()
     {
-        auto eval = m_accumulators.last().evaluate(m_positions.last().side_to_move());
-        eval      = std::clamp(eval, MATED_IN_MAX_PLY + 1, MATE_IN_MAX_PLY - 1);
-        eval -= eval * m_positions.last().halfmove_clock() / 200;
-        return eval;
+        const auto eval = m_accumulators.last().evaluate(m_positions.last().side_to_move());
+        return std::clamp(eval, MATED_IN_MAX_PLY + 1, MATE_IN_MAX_PLY - 1);
+    }
+
+    // the halfmove scaling depends on the path, not only on the position, so it is applied after the tt
+    [[nodiscard]] int32_t adjust_eval(int32_t raw) const
+    {
+        raw -= raw * m_positions.last().halfmove_clock() / 200;
+        return raw;
+    }
+
+    // cached raw eval when the tt has one, fresh one otherwise
+    int32_t raw_evaluate(const std::optional<tt_data_t>& tt_hit)
+    {
+        return tt_hit && tt_hit->m_eval != INVALID_SCORE ? tt_hit->m_eval : raw_evaluate();
     }
 
+    int32_t evaluate() { return adjust_eval(raw_evaluate()); }
+
     [[nodiscard]] bool is_repetition() const { return m_positions.is_repetition(); }
 
     std::span<const Position> positions() { return m_positions.positions(); }
@@ -91,7 +109,7 @@ struct SearchThread
     SearchResult IterativeDeepening();
     int  AspirationWindow(int depth, int prev_eval);
     int  Negamax(int depth, int alpha, int beta);
-    int  QSearch(int alpha, int beta);
+    int  QSearch(int alpha, int beta, int depth = 0);
 };
 
 inline std::vector<Move> get_pv_line(const Position& pos, int max_depth = MAX_PLY)
@@ -105,6 +123,10 @@ inline std::vector<Move> get_pv_line(const Position& pos, int max_depth = MAX_PL
         if (!tt_hit || tt_hit->m_move == Move::none())
             break;
 
+        // a key collision can hand us a move of another position, never play it blindly
+        if (!temp_pos.is_pseudo_legal(tt_hit->m_move) || !temp_pos.is_legal(tt_hit->m_move))
+            break;
+
         pv.push_back(tt_hit->m_move);
         temp_pos.do_move(tt_hit->m_move);
 
@@ -115,13 +137,23 @@ inline std::vector<Move> get_pv_line(const Position& pos, int max_depth = MAX_PL
     return pv;
 }
 
-inline void print_pv_line(const Position& pos, const int depth, const int eval)
+inline std::string uci_score(const int eval)
 {
-    auto pv = get_pv_line(pos, depth);
-    std::cout << "PV (Eval " << eval << "): ";
-    for (auto m : pv)
+    // uci counts mates in moves, not plies
+    if (eval >= MATE_IN_MAX_PLY)
+        return "mate " + std::to_string((MATE - eval + 1) / 2);
+    if (eval <= MATED_IN_MAX_PLY)
+        return "mate -" + std::to_string((MATE + eval) / 2);
+    return "cp " + std::to_string(eval);
+}
+
+inline void print_info_line(const Position& pos, const int depth, const int eval, const uint64_t nodes)
+{
+    std::cout << "info depth " << depth << " score " << uci_score(eval) << " nodes " << nodes << " hashfull "
+              << g_tt.hashfull() << " pv";
+    for (const auto m : get_pv_line(pos, depth))
     {
-        std::cout << m << " ";
+        std::cout << " " << m;
     }
     std::cout << std::endl;
 }
@@ -169,18 +201,7 @@ inline SearchThread::SearchResult SearchThread::IterativeDeepening()
 
             if (m_thread_id == 0)
             {
-                std::string score;
-                if (eval >= MATE_IN_MAX_PLY)
-                {
-                    score.append("mate in ");
-                    score.append(std::to_string(MATE - eval));
-                }
-                else
-                    score = std::to_string(eval);
-
-                std::cout << "Depth " << depth << " Eval " << score << " Nodes " << m_infos.nodes << " best "
-                          << bestMove << std::endl;
-                print_pv_line(m_positions.last(), depth, prev_eval);
+                print_info_line(m_positions.last(), depth, eval, m_infos.nodes);
             }
         }
     }
@@ -326,11 +347,11 @@ inline int SearchThread::Negamax(int depth, int alpha, int beta)
     auto tt_hit = g_tt.probe(pos.hash());
     if (!is_pv && tt_hit)
     {
-        const tt_entry_t& e = *tt_hit;
+        const tt_data_t& e = *tt_hit;
         if (e.m_depth >= depth)
         {
             const int score = read_tt_score(e.m_score, ply());
-            if (e.m_bound == EXACT || (e.m_bound == LOWER && score >= alpha) || (e.m_bound == UPPER && score <= beta))
+            if (e.bound() == EXACT || (e.bound() == LOWER && score >= alpha) || (e.bound() == UPPER && score <= beta))
             {
                 m_infos.tt_hits++;
                 return score;
@@ -338,20 +359,10 @@ inline int SearchThread::Negamax(int depth, int alpha, int beta)
         }
     }
 
-    const int static_eval = tt_hit ? tt_hit->m_score : evaluate();
+    const int raw_eval    = raw_evaluate(tt_hit);
+    const int static_eval = adjust_eval(raw_eval);
     ss.eval = static_eval;
 
-    MoveList moves = gen_legal(pos);
-
-    if (moves.empty())
-    {
-        return in_check ? mated_in(ply()) : 0;
-    }
-
-    score_moves(positions(), moves, tt_hit ? tt_hit->m_move : Move::none(), m_history, ss);
-    moves.sort();
-
-
     if (!is_root && !is_pv && !in_check && static_eval - depth * 100 >= beta)
     {
         return static_eval;
@@ -363,7 +374,7 @@ inline int SearchThread::Negamax(int depth, int alpha, int beta)
     // evaluating is not worth it so we just skip
     // only do it if there are enough pieces to not avoid zugzwang blindness
     if (!is_root && !is_pv && positions().back().move() != Move::null() && !in_check && depth >= 3 && static_eval >= beta &&
-        (!tt_hit || tt_hit->m_bound != UPPER || tt_hit->m_score > beta) && std::abs(static_eval) < MATE_IN_MAX_PLY &&
+        (!tt_hit || tt_hit->bound() != UPPER || tt_hit->m_score > beta) && std::abs(static_eval) < MATE_IN_MAX_PLY &&
         pos.occupancy(KNIGHT, BISHOP, ROOK, QUEEN).popcount() >= 3) // add loss condition ?
     {
         const int reduction = 3 + depth / 3 + std::clamp((static_eval - beta) / 100, 0, 4);
@@ -389,13 +400,15 @@ inline int SearchThread::Negamax(int depth, int alpha, int beta)
         int       prob_beta = beta + 150;
         const int reduction = 3;
 
-        MoveList  tactical  = filter_tactical(pos, gen_legal(pos));
+        MoveList  tactical{};
+        gen_moves<CAPTURES>(pos, tactical);
+        gen_moves<QUIET_CHECKS>(pos, tactical);
         score_moves(positions(), tactical, tt_hit ? tt_hit->m_move : Move::none(), m_history, ss);
         tactical.sort();
 
         for (auto [m, s] : tactical)
         {
-            if (m == tt_hit->m_move || s < -1000)
+            if ((tt_hit && m == tt_hit->m_move) || !pos.see_ge(m, -100) || !pos.is_legal(m))
             {
                 continue;
             }
@@ -432,13 +445,11 @@ inline int SearchThread::Negamax(int depth, int alpha, int beta)
     int      move_idx   = 0;
     MoveList quiets{};
 
-    for (auto [m, s] : moves)
+    MovePicker picker(positions(), tt_hit ? tt_hit->m_move : Move::none(), m_history, ss);
+    for (Move m = picker.next(); m != Move::none(); m = picker.next())
     {
 
         bool is_quiet = !pos.is_occupied(m.to_sq()) && m.type_of() != EN_PASSANT && m.type_of() != PROMOTION;
-        if (is_quiet)
-            quiets.push_back(m);
-
 
 
         if (!is_root && !is_pv && !in_check && best_eval != -INF_SCORE && is_quiet && depth <= FUTILITY_DEPTH_MAX)
@@ -463,6 +474,16 @@ inline int SearchThread::Negamax(int depth, int alpha, int beta)
             }
         }
 
+        // only moves that get past pruning pay for the legality check
+        // pruning needs a searched move first, so an illegal move can not hide a mate or a stalemate
+        if (!pos.is_legal(m))
+        {
+            continue;
+        }
+
+        if (is_quiet)
+            quiets.push_back(m);
+
         int search_depth = depth;
 
 
@@ -537,6 +558,12 @@ inline int SearchThread::Negamax(int depth, int alpha, int beta)
         }
     }
 
+    // nothing searched means nothing was legal
+    if (best_eval == -INF_SCORE)
+    {
+        return in_check ? mated_in(ply()) : 0;
+    }
+
     bool best_valid = !m_tm.should_stop() && local_best != Move::none();
     if (is_root && best_valid)
         bestMove = local_best;
@@ -550,12 +577,12 @@ inline int SearchThread::Negamax(int depth, int alpha, int beta)
         bound = EXACT;
 
     if (best_valid)
-        g_tt.store(pos.hash(), depth, store_tt_score(best_eval, ply()), bound, local_best);
+        g_tt.store(pos.hash(), depth, store_tt_score(best_eval, ply()), bound, local_best, raw_eval);
 
     return best_eval;
 }
 
-inline int SearchThread::QSearch(int alpha, int beta)
+inline int SearchThread::QSearch(int alpha, int beta, const int depth)
 {
     m_infos.nodes++;
 
@@ -572,58 +599,67 @@ inline int SearchThread::QSearch(int alpha, int beta)
     if (is_repetition())
         return 0;
 
-    const MoveList moves = gen_legal(pos);
-    if (moves.empty())
-    {
-        if (pos.checkers(pos.side_to_move()))
-        {
-            return mated_in(ply());
-        }
-        return 0;
-    }
+    const bool in_check = pos.checkers(pos.side_to_move()).value();
 
     auto tt_hit = g_tt.probe(pos.hash());
     if (!is_pv && tt_hit)
     {
-        const tt_entry_t& e     = *tt_hit;
-        const int         score = read_tt_score(e.m_score, ply());
-        if (e.m_bound == EXACT)
+        const tt_data_t& e     = *tt_hit;
+        const int        score = read_tt_score(e.m_score, ply());
+        if (e.bound() == EXACT)
             return score;
-        if (e.m_bound == LOWER && score >= alpha)
+        if (e.bound() == LOWER && score >= alpha)
             return score;
-        if (e.m_bound == UPPER && score <= beta)
+        if (e.bound() == UPPER && score <= beta)
             return score;
     }
 
-    const int stand_pat = evaluate();
+    const int stand_pat = adjust_eval(raw_evaluate(tt_hit));
     ss.eval = stand_pat;
 
-    if (stand_pat >= beta)
-        return beta;
-    if (stand_pat > alpha)
-        alpha = stand_pat;
-
-    //std::cout << "qsearch move loop "  << std::endl;
-    MoveList tactical = filter_tactical(pos, moves);
-    //std::ranges::for_each(tactical, [&](auto m) {std::cout << m.move << std::endl;});
+    // in check standing pat is not an option, every evasion is searched and none legal is mate
+    int      best_eval = -INF_SCORE;
+    MoveList tactical;
+    if (in_check)
+    {
+        gen_moves<EVASIONS>(pos, tactical);
+    }
+    else
+    {
+        if (stand_pat >= beta)
+            return beta;
+        if (stand_pat > alpha)
+            alpha = stand_pat;
+        best_eval = stand_pat;
+
+        // quiet checks only right after the main search, deeper they would keep feeding evasions to each other
+        gen_moves<CAPTURES>(pos, tactical);
+        if (depth == 0)
+            gen_moves<QUIET_CHECKS>(pos, tactical);
+    }
 
     score_moves(positions(), tactical, tt_hit ? tt_hit->m_move : Move::none(), m_history, ss);
     tactical.sort();
 
-    int best_eval = stand_pat;
+    bool searched = false;
     for (auto [m, s] : tactical)
     {
-        //std::cout << m << std::endl;
-        if (!is_pv && pos.is_occupied(m.to_sq()) && s < -1000) // see pruning on captures
+        if (!is_pv && !in_check && pos.is_occupied(m.to_sq()) && !pos.see_ge(m, -100)) // see pruning on captures
+        {
+            continue;
+        }
+
+        if (!pos.is_legal(m))
         {
             continue;
         }
 
         do_move(m);
 
-        const int score = -QSearch(-beta, -alpha);
+        const int score = -QSearch(-beta, -alpha, depth - 1);
 
         undo_move();
+        searched = true;
 
         if (m_tm.should_stop())
         {
@@ -637,6 +673,11 @@ inline int SearchThread::QSearch(int alpha, int beta)
         if (alpha >= beta)
             break;
     }
+
+    if (in_check && !searched)
+    {
+        return mated_in(ply());
+    }
     return best_eval;
 }
 
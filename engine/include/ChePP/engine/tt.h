@@ -5,10 +5,18 @@
 #ifndef TT_H
 #define TT_H
 
+#include "memory.h"
 #include "types.h"
 
-#include <bits/shared_ptr_base.h>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <optional>
+#include <string>
+#include <thread>
 #include <vector>
 #include "ChePP/engine/zobrist.h"
 
@@ -18,87 +26,345 @@ enum tt_bound_t : uint8_t {
     UPPER,
 };
 
+// the payload of an entry, packed in 8 bytes
+// depth is stored in a byte, bound and generation share the other one
+struct tt_data_t
+{
+    static constexpr int     BOUND_BITS      = 2;
+    static constexpr uint8_t BOUND_MASK      = (1 << BOUND_BITS) - 1;
+    static constexpr int     GENERATION_SPAN = 1 << (8 - BOUND_BITS);
+
+    tt_data_t() noexcept = default;
+    tt_data_t(const int depth, const int score, const int eval, const tt_bound_t bound, const int generation,
+              const Move move)
+        : m_move(move), m_score(static_cast<int16_t>(score)), m_eval(static_cast<int16_t>(eval)),
+          m_depth(static_cast<uint8_t>(std::clamp(depth, 0, 255))),
+          m_gen_bound(static_cast<uint8_t>((generation << BOUND_BITS) | bound))
+    {
+    }
+
+    [[nodiscard]] tt_bound_t bound() const { return static_cast<tt_bound_t>(m_gen_bound & BOUND_MASK); }
+    [[nodiscard]] int        generation() const { return m_gen_bound >> BOUND_BITS; }
+
+    Move     m_move{};
+    int16_t  m_score{0};
+    int16_t  m_eval{INVALID_SCORE};
+    uint8_t  m_depth{0};
+    uint8_t  m_gen_bound{0};
+};
+
+static_assert(sizeof(tt_data_t) == 8);
+
+// search threads read and write entries concurrently without any lock
+// the key is stored xored with the payload: a torn entry (key and data from two different writes)
+// does not verify against the probed hash, so it is seen as a miss instead of returning foreign data
 struct tt_entry_t
 {
+    // each word is read once, the entry may be rewritten by another thread at any time
+    [[nodiscard]] std::optional<tt_data_t> read(const hash_t hash) const
+    {
+        const uint64_t raw = load(m_data);
+        if ((load(m_key) ^ raw) != hash)
+            return std::nullopt;
+        return std::bit_cast<tt_data_t>(raw);
+    }
+
+    [[nodiscard]] bool empty() const { return load(m_key) == 0 && load(m_data) == 0; }
+
+    // unverified payload, only good enough to pick a replacement victim
+    [[nodiscard]] tt_data_t data() const { return std::bit_cast<tt_data_t>(load(m_data)); }
+
+    void write(const hash_t hash, const tt_data_t& data)
+    {
+        const auto raw = std::bit_cast<uint64_t>(data);
+        store(m_data, raw);
+        store(m_key, hash ^ raw);
+    }
+
+    uint64_t m_key{0};
+    uint64_t m_data{0};
 
-    tt_entry_t() noexcept = default;
-    tt_entry_t(const hash_t hash, const int depth, const int score, const tt_bound_t bound, const int generation, const Move move)
-        : m_hash(hash), m_depth(depth), m_score(score), m_move(move), m_bound(bound), m_generation(generation)
+  private:
+    static uint64_t load(const uint64_t& word)
     {
+        return std::atomic_ref(const_cast<uint64_t&>(word)).load(std::memory_order_relaxed);
     }
+    static void store(uint64_t& word, const uint64_t value)
+    {
+        std::atomic_ref(word).store(value, std::memory_order_relaxed);
+    }
+};
 
-    hash_t  m_hash;
-    uint16_t m_depth;
-    int16_t m_score;
-    Move m_move;
-    tt_bound_t m_bound;
-    uint8_t m_generation;
-    uint8_t m_repetitions{0};
+static_assert(sizeof(tt_entry_t) == 16);
+
+// one cluster is exactly one cache line, a probe costs a single miss and sees every candidate entry
+struct alignas(64) tt_cluster_t
+{
+    static constexpr size_t N_ENTRIES = 4;
+    std::array<tt_entry_t, N_ENTRIES> m_entries{};
 };
 
+static_assert(sizeof(tt_cluster_t) == 64);
+
 
-inline uint64_t floor_power_of_two(const uint64_t x) {
-    if (x == 0) return 0;
-    return 1ULL << (63 - __builtin_clzll(x));
-}
+// header of a saved table, a file is only loaded back if every field matches what this binary expects
+// entries cache raw static evals, so the table is also tied to the net that produced them
+struct tt_file_header_t
+{
+    static constexpr std::array<char, 8> MAGIC   = {'C', 'H', 'E', 'P', 'P', 'T', 'T', '\0'};
+    static constexpr uint32_t            VERSION = 2;
+
+    std::array<char, 8> m_magic{MAGIC};
+    uint32_t            m_version{VERSION};
+    uint32_t            m_cluster_size{sizeof(tt_cluster_t)};
+    uint32_t            m_entry_size{sizeof(tt_entry_t)};
+    uint32_t            m_generation{0};
+    hash_t              m_zobrist{zobrist_t::fingerprint()};
+    uint64_t            m_clusters{0};
+    uint64_t            m_net_hash{0};
+
+    [[nodiscard]] bool compatible(const uint64_t net_hash) const
+    {
+        const tt_file_header_t expected{};
+        return m_magic == expected.m_magic && m_version == expected.m_version &&
+               m_cluster_size == expected.m_cluster_size && m_entry_size == expected.m_entry_size &&
+               m_zobrist == expected.m_zobrist && m_generation < tt_data_t::GENERATION_SPAN && m_clusters > 0 &&
+               m_net_hash == net_hash;
+    }
+};
 
 struct tt_t
 {
 
-    void init (const size_t mb)
+    // false when the memory could not be allocated, the current table is then kept as is
+    [[nodiscard]] bool init(const size_t mb, const size_t n_threads = 1)
     {
-        m_size = floor_power_of_two(mb * 1024 * 1024 / sizeof(tt_entry_t));
-        m_table.resize(m_size);
-        std::ranges::fill(m_table, tt_entry_t());
+        return resize(std::max<size_t>(1, mb * 1024 * 1024 / sizeof(tt_cluster_t)), n_threads);
     }
 
-    void reset()
+    // each thread zeroes its own slice, for a fresh table this is also the first touch
+    // so pages end up spread over the nodes of the threads that will use them
+    void reset(const size_t n_threads = 1)
     {
-        std::ranges::fill(m_table, tt_entry_t());
+        const size_t n     = std::clamp<size_t>(n_threads, 1, std::max<size_t>(1, m_size));
+        const size_t slice = (m_size + n - 1) / n;
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(n);
+            for (size_t begin = 0; begin < m_size; begin += slice)
+            {
+                const size_t count = std::min(slice, m_size - begin);
+                workers.emplace_back(
+                    [this, begin, count]
+                    { std::memset(static_cast<void*>(m_table + begin), 0, count * sizeof(tt_cluster_t)); });
+            }
+        }
+        m_generation = 0;
     }
 
-    void prefetch(hash_t hash) const noexcept {
-        const size_t idx = index(hash);
-        __builtin_prefetch(&m_table[idx], 0, 3);
+    // only applies to the next init
+    void set_numa_interleave(const bool interleave) { m_numa_interleave = interleave; }
+
+    [[nodiscard]] size_t size_mb() const { return m_size * sizeof(tt_cluster_t) / (1024 * 1024); }
+
+    // dump the table so a later run can pick up where this one stopped
+    // net_hash identifies the net whose evals are cached, load only accepts the file under the same one
+    // must not run concurrently with a search
+    [[nodiscard]] bool save(const std::string& path, const uint64_t net_hash) const
+    {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            return false;
+
+        tt_file_header_t header{};
+        header.m_generation = m_generation;
+        header.m_clusters   = m_size;
+        header.m_net_hash   = net_hash;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_chunked(out, reinterpret_cast<const char*>(m_table), m_size * sizeof(tt_cluster_t));
+        return static_cast<bool>(out);
     }
 
-    [[nodiscard]] std::optional<tt_entry_t> probe(const hash_t hash) const
+    // the file must have been saved with the current hash size, the table never silently leaves the hash option
+    // it is read into a fresh buffer that replaces the table only once fully read, on failure the table is untouched
+    [[nodiscard]] bool load(const std::string& path, const uint64_t net_hash)
     {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
 
-        const tt_entry_t& cur = m_table[index(hash)];
-        if (cur.m_hash != hash)
+        tt_file_header_t header{};
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || !header.compatible(net_hash) || header.m_clusters != m_size)
+            return false;
+
+        std::error_code ec;
+        const auto      file_size = std::filesystem::file_size(path, ec);
+        if (ec || file_size != sizeof(header) + m_size * sizeof(tt_cluster_t))
+            return false;
+
+        LargePageBuffer mem;
+        try
         {
-            return std::nullopt;
+            mem = LargePageBuffer{m_size * sizeof(tt_cluster_t), m_numa_interleave};
+        }
+        catch (const std::bad_alloc&)
+        {
+            return false;
         }
-        return cur;
+        read_chunked(in, static_cast<char*>(mem.data()), m_size * sizeof(tt_cluster_t));
+        if (!in)
+            return false;
+
+        m_mem        = std::move(mem);
+        m_table      = static_cast<tt_cluster_t*>(m_mem.data());
+        m_generation = static_cast<int>(header.m_generation);
+        return true;
     }
 
-    void store(const hash_t hash, const int depth, const int score, tt_bound_t bound, const Move move)
+    // permille of entries written during the current search, estimated on the first clusters
+    [[nodiscard]] int hashfull() const
     {
-        const tt_entry_t& cur = m_table[index(hash)];
-        const auto  entry = tt_entry_t(hash , depth, score, bound, m_generation, move);
-        bool replace = cur.m_depth <= depth  || cur.m_generation != m_generation ||
-            (cur.m_bound != EXACT && bound == EXACT) || cur.m_hash != hash;
-        if (replace) {
-            //if (cur.m_bound == EXACT) return;
-            m_table[index(hash)] = entry;
+        const size_t sample = std::min<size_t>(1000, m_size);
+        size_t       used   = 0;
+        for (size_t i = 0; i < sample; ++i)
+        {
+            for (const auto& e : m_table[i].m_entries)
+            {
+                used += !e.empty() && e.data().generation() == m_generation;
+            }
         }
+        return static_cast<int>(used * 1000 / (sample * tt_cluster_t::N_ENTRIES));
+    }
+
+    void prefetch(hash_t hash) const noexcept {
+        __builtin_prefetch(&cluster(hash), 0, 3);
+    }
+
+    [[nodiscard]] std::optional<tt_data_t> probe(const hash_t hash) const
+    {
+        for (const auto& e : cluster(hash).m_entries)
+        {
+            if (const auto data = e.read(hash))
+            {
+                return data;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void store(const hash_t hash, const int depth, const int score, tt_bound_t bound, const Move move,
+               const int eval = INVALID_SCORE)
+    {
+        auto& entries = cluster(hash).m_entries;
+
+        // an entry of the same position is always the one we overwrite, we never keep two copies
+        // otherwise we evict the entry that is the least useful : shallow and from an old search
+        tt_entry_t* replace = &entries[0];
+        tt_data_t   cur     = replace->data();
+        bool        same    = false;
+        for (auto& e : entries)
+        {
+            if (const auto data = e.read(hash))
+            {
+                replace = &e;
+                cur     = *data;
+                same    = true;
+                break;
+            }
+            if (const tt_data_t data = e.data(); worth(data) < worth(cur))
+            {
+                replace = &e;
+                cur     = data;
+            }
+        }
+
+        if (same)
+        {
+            // keep the deeper result of the current search unless the new one is exact
+            const bool keep = cur.generation() == m_generation && cur.m_depth > depth + 2 && bound != EXACT;
+            if (keep)
+                return;
+        }
+
+        const Move kept_move = same && move == Move::none() ? cur.m_move : move;
+        const int  kept_eval = same && eval == INVALID_SCORE ? cur.m_eval : eval;
+        replace->write(hash, tt_data_t(depth, score, kept_eval, bound, m_generation, kept_move));
     }
 
     void new_generation()
     {
-        m_generation++;
+        m_generation = (m_generation + 1) % tt_data_t::GENERATION_SPAN;
     }
 
 private:
+    // any table size works, not only powers of two, so a hash can use (almost) all the memory it is given
+    // the top bits pick the cluster, the full key still verifies the entry
     [[nodiscard]] size_t index(const hash_t hash) const
     {
-        return hash & (m_size - 1);
+        return static_cast<size_t>((static_cast<unsigned __int128>(hash) * m_size) >> 64);
+    }
+
+    [[nodiscard]] tt_cluster_t&       cluster(const hash_t hash) { return m_table[index(hash)]; }
+    [[nodiscard]] const tt_cluster_t& cluster(const hash_t hash) const { return m_table[index(hash)]; }
+
+    // streams take a signed count, multi-GB tables go through in bounded pieces
+    static constexpr size_t IO_CHUNK = 64 * 1024 * 1024;
+
+    static void write_chunked(std::ofstream& out, const char* data, size_t bytes)
+    {
+        while (bytes > 0 && out)
+        {
+            const size_t chunk = std::min(bytes, IO_CHUNK);
+            out.write(data, static_cast<std::streamsize>(chunk));
+            data += chunk;
+            bytes -= chunk;
+        }
+    }
+
+    static void read_chunked(std::ifstream& in, char* data, size_t bytes)
+    {
+        while (bytes > 0 && in)
+        {
+            const size_t chunk = std::min(bytes, IO_CHUNK);
+            in.read(data, static_cast<std::streamsize>(chunk));
+            data += chunk;
+            bytes -= chunk;
+        }
+    }
+
+    // the new table is allocated while the old one is still in place, a failed resize must leave a usable table
+    // so both are alive for a moment, a multi-GB resize needs the memory for both
+    bool resize(const size_t clusters, const size_t n_threads)
+    {
+        LargePageBuffer mem;
+        try
+        {
+            mem = LargePageBuffer{clusters * sizeof(tt_cluster_t), m_numa_interleave};
+        }
+        catch (const std::bad_alloc&)
+        {
+            return false;
+        }
+        m_mem   = std::move(mem);
+        m_size  = clusters;
+        m_table = static_cast<tt_cluster_t*>(m_mem.data());
+        reset(n_threads);
+        return true;
+    }
+
+    // each generation of age costs as much as 8 plies of depth
+    [[nodiscard]] int worth(const tt_data_t& data) const
+    {
+        const int age = (tt_data_t::GENERATION_SPAN + m_generation - data.generation()) % tt_data_t::GENERATION_SPAN;
+        return data.m_depth - 8 * age;
     }
 
-    int m_generation = 0;
-    std::size_t m_size = 0;
-    std::vector<tt_entry_t> m_table;
+    int             m_generation      = 0;
+    std::size_t     m_size            = 0;
+    bool            m_numa_interleave = false;
+    LargePageBuffer m_mem{};
+    tt_cluster_t*   m_table = nullptr;
 };
 
 inline tt_t g_tt;
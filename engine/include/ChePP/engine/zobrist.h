@@ -49,6 +49,9 @@ struct zobrist_t
 
     void flip_color() { m_hash ^= s_side; }
 
+    // identifies the key set, data hashed with other keys (another build) is meaningless to us
+    static constexpr hash_t fingerprint();
+
     static const EnumArray<Piece, EnumArray<Square, hash_t>> s_psq;
     static const EnumArray<File, hash_t>                     s_ep;
     static const EnumArray<CastlingType, hash_t>             s_castling;
@@ -101,4 +104,17 @@ constexpr EnumArray<CastlingType, hash_t>             zobrist_t::s_castling = st
 constexpr hash_t                                      zobrist_t::s_side     = std::get<3>(zobrist_tables);
 constexpr hash_t                                      zobrist_t::s_no_pawns = std::get<4>(zobrist_tables);
 
+constexpr hash_t zobrist_t::fingerprint()
+{
+    hash_t h = combine(s_side, s_no_pawns);
+    for (const Piece pc : Piece::values())
+        for (const Square sq : Square::values())
+            h = combine(h, s_psq.at(pc).at(sq));
+    for (const File fl : File::values())
+        h = combine(h, s_ep.at(fl));
+    for (const CastlingType ct : CastlingType::values())
+        h = combine(h, s_castling.at(ct));
+    return h;
+}
+
 #endif // ZOBRIST_H
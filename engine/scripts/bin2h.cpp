@@ -1,5 +1,5 @@
 #include <cstdint>
-#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -9,6 +9,10 @@
 #include <unordered_map>
 #include <vector>
 
+// Declares every layer of format.txt as a typed, aligned symbol in a header, and defines the symbols in an
+// assembly file that pulls the raw bytes of the net in with .incbin.
+// The compiler never sees the weights, only the assembler copies them, which is what keeps the build fast.
+
 enum class LayerType : uint8_t {
     UINT8=1, INT8, UINT16, INT16, UINT32, INT32, UINT64, INT64, FLOAT, DOUBLE
 };
@@ -21,14 +25,25 @@ struct LayerBase {
     virtual ~LayerBase() = default;
 
     [[nodiscard]] virtual std::string cpp_type() const = 0;
-    [[nodiscard]] virtual std::string literal_suffix() const = 0;
     [[nodiscard]] virtual size_t type_size() const = 0;
 
+    [[nodiscard]] uint64_t bytes() const { return size * type_size(); }
+
     void emit_declaration(std::ofstream &h) const {
-        h << "alignas(64) extern " << cpp_type() << " " << name << "[" << size << "];\n";
+        h << "extern \"C\" alignas(64) const " << cpp_type() << " " << name << "[" << size << "];\n";
     }
 
-    virtual void emit_definition(std::ofstream &cpp, const uint8_t* data) const = 0;
+    // SYM() adds the leading underscore Mach-O wants, ELF only targets get the symbol type and size
+    void emit_definition(std::ofstream &s, const std::string& raw_path, const uint64_t offset) const {
+        s << "    .balign 64\n"
+          << "    .globl SYM(" << name << ")\n"
+          << "#if defined(__ELF__)\n"
+          << "    .type SYM(" << name << "), @object\n"
+          << "    .size SYM(" << name << "), " << bytes() << "\n"
+          << "#endif\n"
+          << "SYM(" << name << "):\n"
+          << "    .incbin \"" << raw_path << "\", " << offset << ", " << bytes() << "\n\n";
+    }
 };
 
 template<typename T>
@@ -48,32 +63,7 @@ struct LayerImpl final : LayerBase {
         else if constexpr(std::is_same_v<T,double>) return "double";
     }
 
-    [[nodiscard]] std::string literal_suffix() const override {
-        if constexpr(std::is_same_v<T,uint32_t>) return "UL";
-        else if constexpr(std::is_same_v<T,int32_t>) return "L";
-        else if constexpr(std::is_same_v<T,uint64_t>) return "ULL";
-        else if constexpr(std::is_same_v<T,int64_t>) return "LL";
-        else if constexpr(std::is_same_v<T,float>) return "f";
-        else if constexpr(std::is_same_v<T,double>) return "d";
-        else return "";
-    }
-
     size_t type_size() const override { return sizeof(T); }
-
-    void emit_definition(std::ofstream& cpp, const uint8_t* data) const override {
-        cpp << "alignas(64) " << cpp_type() << " " << name << "[" << size << "] = {";
-        const T* arr = reinterpret_cast<const T*>(data);
-        for(uint64_t i=0;i<size;i++){
-            if(i%8==0) cpp << "\n  ";
-            if constexpr(std::is_same_v<T,uint8_t> || std::is_same_v<T,int8_t>) {
-                cpp << +arr[i];
-            } else {
-                cpp << arr[i] << literal_suffix();
-            }
-            cpp << ", ";
-        }
-        cpp << "\n};\n\n";
-    }
 };
 
 LayerType parse_type(const std::string &s) {
@@ -107,19 +97,21 @@ std::unique_ptr<LayerBase> make_layer(const LayerType t, uint64_t size, const st
 
 int main(int argc,char**argv){
     if(argc!=5){
-        std::cerr<<"Usage: "<<argv[0]<<" <raw.bin> <config.txt> <output.h> <output.cpp>\n";
+        std::cerr<<"Usage: "<<argv[0]<<" <raw.bin> <config.txt> <output.h> <output.S>\n";
         return 1;
     }
 
+    // .incbin resolves relative paths against the assembler's working directory, so always give it an absolute one
+    std::error_code ec;
+    const auto raw_path = std::filesystem::absolute(argv[1], ec);
+    const auto raw_size = std::filesystem::file_size(raw_path, ec);
+    if(ec){ std::cerr<<"Failed to open "<<argv[1]<<"\n"; return 1; }
+
     std::ifstream cfg(argv[2]);
-    std::ifstream raw(argv[1],std::ios::binary);
     std::ofstream h(argv[3]);
-    std::ofstream cpp(argv[4]);
+    std::ofstream s(argv[4]);
 
-    if(!cfg || !raw || !h || !cpp){ std::cerr<<"Failed to open files\n"; return 1; }
-
-    h << "#pragma once\n#include <cstdint>\n\n";
-    cpp << "#include \"" << argv[3] << "\"\n\n";
+    if(!cfg || !h || !s){ std::cerr<<"Failed to open files\n"; return 1; }
 
     std::vector<std::unique_ptr<LayerBase>> layers;
     std::string type_str, name;
@@ -130,16 +122,30 @@ int main(int argc,char**argv){
         layers.push_back(make_layer(t,size,name));
     }
 
+    h << "#pragma once\n#include <cstdint>\n\n";
+    s << "// generated by bin2h from " << argv[2] << ", do not edit\n\n"
+      << "#if defined(__APPLE__)\n#define SYM(x) _##x\n    .const\n#else\n#define SYM(x) x\n    .section .rodata\n#endif\n\n";
+
+    uint64_t offset = 0;
     for(auto &layer : layers){
         layer->emit_declaration(h);
+        layer->emit_definition(s, raw_path.string(), offset);
+        offset += layer->bytes();
+    }
+
+    if(offset > raw_size){ std::cerr<<"Raw file too small\n"; return 1; }
 
-        size_t bytes = layer->type_size() * layer->size;
-        std::vector<uint8_t> buf(bytes);
-        raw.read(reinterpret_cast<char*>(buf.data()), bytes);
-        if(!raw){ std::cerr<<"Raw file too small\n"; return 1; }
+    s << "#if defined(__ELF__)\n    .section .note.GNU-stack,\"\",@progbits\n#endif\n";
 
-        layer->emit_definition(cpp, buf.data());
+    // the layout of a net file, so the engine can load other nets at runtime
+    h << "\nstruct network_layer_t {\n    const char* name;\n    uint32_t type_size;\n    uint64_t size;\n"
+         "    const void* data;\n};\n\n";
+    h << "inline constexpr network_layer_t g_network_layers[] = {\n";
+    for(auto &layer : layers){
+        h << "    {\"" << layer->name << "\", " << layer->type_size() << ", " << layer->size << ", " << layer->name
+          << "},\n";
     }
+    h << "};\n";
 
     std::cout<<"Embedded all layers into "<<argv[3]<<" and "<<argv[4]<<"\n";
 }
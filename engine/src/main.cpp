@@ -5,9 +5,18 @@
 #include "ChePP/engine/movegen.h"
 #include "ChePP/engine/search.h"
 #include "ChePP/engine/UCI.h"
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <iostream>
 
@@ -23,6 +32,9 @@ void perft_divide(const Position& prev, int depth) {
 
     for (auto [mv, _] : l)
     {
+        if (!prev.is_legal(mv))
+            continue;
+
         Position next = prev;
         next.do_move(mv);
 
@@ -68,8 +80,128 @@ void print_accumulator(accumulator_t<nnue_t::s_accumulator_size>& acc, color_t c
  */
 
 
-int main() {
-    g_tt.init(512);
+// full refreshes and evaluations over a few positions, with the instruction set the kernels were dispatched to
+int bench(const size_t iterations) {
+    constexpr std::array fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    };
+    std::vector<Position> positions(fens.size());
+    for (size_t i = 0; i < fens.size(); ++i)
+        positions[i].from_fen(fens[i]);
+
+    int64_t    sink  = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        const Position&   pos = positions[i % positions.size()];
+        const Accumulator acc{pos};
+        sink += acc.evaluate(pos.side_to_move());
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations);
+
+    // the same positions through the batch api
+    std::vector<Position> batch(1024);
+    std::vector<int32_t>  evals(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i)
+        batch[i] = positions[i % positions.size()];
+    const size_t rounds      = std::max<size_t>(1, iterations / batch.size());
+    const auto   batch_start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        Accumulator::evaluate_batch(batch, evals);
+        sink += evals[r % evals.size()];
+    }
+    const auto   batch_end = std::chrono::steady_clock::now();
+    const double batch_ns  = std::chrono::duration<double, std::nano>(batch_end - batch_start).count() /
+                            static_cast<double>(rounds * batch.size());
+
+    std::cout << "nnue target " << nnue_kernels::target_name() << "\n";
+    std::cout << "refresh + evaluate " << ns << " ns\n";
+    std::cout << "batched refresh + evaluate " << batch_ns << " ns\n";
+    std::cout << "checksum " << sink << std::endl;
+    return 0;
+}
+
+// static evaluation of every FEN or EPD line of a file, written back as "<line>\t<eval>" for the side to move
+// positions are evaluated in batches, lines that do not parse are reported on stderr and skipped
+int evaluate_file(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Could not open " << path << std::endl;
+        return 1;
+    }
+
+    constexpr size_t CHUNK = 4096;
+    std::vector<std::string> lines;
+    std::vector<Position>    positions;
+    std::vector<int32_t>     evals;
+    const auto flush = [&] {
+        evals.resize(positions.size());
+        Accumulator::evaluate_batch(positions, evals);
+        for (size_t i = 0; i < positions.size(); ++i)
+            std::cout << lines[i] << '\t' << evals[i] << '\n';
+        lines.clear();
+        positions.clear();
+    };
+
+    std::string line;
+    while (std::getline(in, line)) {
+        // an epd line stops after the en passant square, its clocks are those of a fresh game
+        std::istringstream iss(line);
+        std::string        board, side, castling, ep, halfmove, fullmove;
+        iss >> board >> side >> castling >> ep >> halfmove >> fullmove;
+        if (board.empty())
+            continue;
+        const auto is_number = [](const std::string& s) {
+            return !s.empty() && std::isdigit(static_cast<unsigned char>(s[0]));
+        };
+        const std::string clocks = is_number(halfmove) && is_number(fullmove) ? halfmove + " " + fullmove : "0 1";
+        const std::string fen    = board + " " + side + " " + castling + " " + ep + " " + clocks;
+
+        Position pos;
+        if (!pos.from_fen(fen)) {
+            std::cerr << "Skipping invalid position: " << line << "\n";
+            continue;
+        }
+        lines.push_back(line);
+        positions.push_back(pos);
+        if (positions.size() == CHUNK)
+            flush();
+    }
+    flush();
+    std::cout << std::flush;
+    return 0;
+}
+
+int main(const int argc, char** argv) {
+    // ChePP evaluate <fen or epd file>
+    if (argc >= 3 && std::string_view(argv[1]) == "evaluate")
+        return evaluate_file(argv[2]);
+
+    // ChePP bench [iterations]
+    if (argc >= 2 && std::string_view(argv[1]) == "bench")
+        return bench(argc >= 3 ? std::max<size_t>(1, std::strtoull(argv[2], nullptr, 10)) : 1'000'000);
+
+    // ChePP export-net <blob> [net]: writes a net, the embedded one by default, as a blob EvalFile can map
+    if (argc >= 3 && std::string_view(argv[1]) == "export-net")
+    {
+        if (argc >= 4 && !g_net.load(argv[3]))
+        {
+            std::cerr << "Could not load network " << argv[3] << std::endl;
+            return 1;
+        }
+        if (!g_net.save_blob(argv[2]))
+        {
+            std::cerr << "Could not write " << argv[2] << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << g_net.name() << " to " << argv[2] << std::endl;
+        return 0;
+    }
 
     UCIEngine engine{};
     engine.loop();
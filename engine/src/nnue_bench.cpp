@@ -0,0 +1,191 @@
+//
+// Created by paul on 10/16/26.
+//
+
+// times the accumulator update kernels on the change shapes search actually produces
+// and the lane per output layout of l2 against one horizontal sum per output
+// and the whole evaluation against its scalar reference
+// the update kernels go through the runtime dispatch, the layout comparison is built for the static target only
+// usage: ChePP_nnue_bench [iterations]
+
+#include "ChePP/engine/nnue.h"
+
+#include <hwy/highway.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+HWY_BEFORE_NAMESPACE();
+namespace
+{
+
+using namespace hwy::HWY_NAMESPACE;
+
+using FeatureT = FeatureTransformer::FeatureT;
+using Features = FeatureTransformer::RetT;
+
+// a few distinct rows so weights come from cache like they mostly do in search
+constexpr size_t N_ROWS = 64;
+
+struct Sample
+{
+    Features add;
+    Features sub;
+};
+
+std::vector<Sample> make_samples(const size_t n_add, const size_t n_sub, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> feature(0, FeatureTransformer::n_features_v - 1);
+    std::vector<Sample>                samples(N_ROWS);
+    for (auto& [add, sub] : samples)
+    {
+        for (size_t k = 0; k < n_add; ++k)
+            add.push_back(static_cast<FeatureT>(feature(rng)));
+        for (size_t k = 0; k < n_sub; ++k)
+            sub.push_back(static_cast<FeatureT>(feature(rng)));
+    }
+    return samples;
+}
+
+template <typename Kernel>
+double time_kernel(const std::vector<Sample>& samples, const size_t iterations, Kernel&& kernel, int16_t& sink)
+{
+    alignas(64) Accumulator::AccumulatorT a{};
+    alignas(64) Accumulator::AccumulatorT b{};
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        // ping pong between two buffers like parent and child accumulators
+        const auto& s = samples[i % samples.size()];
+        if (i & 1)
+            kernel(a.data(), b.data(), s);
+        else
+            kernel(b.data(), a.data(), s);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    sink ^= a[0] ^ b[Accumulator::OutSz - 1];
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations);
+}
+
+template <size_t N_ADD, size_t N_SUB>
+void bench_shape(const std::string& name, const size_t iterations, std::mt19937& rng, int16_t& sink)
+{
+    const auto samples = make_samples(N_ADD, N_SUB, rng);
+
+    const double generic = time_kernel(samples, iterations,
+                                       [](int16_t* dst, const int16_t* src, const Sample& s)
+                                       { Accumulator::add_sub(dst, src, s.add, s.sub); }, sink);
+    const double fused   = time_kernel(samples, iterations,
+                                       [](int16_t* dst, const int16_t* src, const Sample& s)
+                                       { Accumulator::add_sub<N_ADD, N_SUB>(dst, src, s.add.data(), s.sub.data()); },
+                                       sink);
+
+    std::cout << name << "\tgeneric " << generic << " ns\tfused " << fused << " ns\tspeedup " << generic / fused
+              << "\n";
+}
+
+// layer layouts: one output per dot product then a horizontal sum, against one output per lane
+
+template <typename Fn>
+double time_eval(const size_t iterations, Fn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        fn();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations);
+}
+
+constexpr size_t L2_IN  = L2Interleaved::InSz;
+constexpr size_t L2_OUT = L2Interleaved::OutSz;
+
+int32_t l2_reduce(const int32_t* in)
+{
+    using D32 = CappedTag<int32_t, L2_IN>;
+    using D16 = Rebind<int16_t, D32>;
+
+    int32_t sum = 0;
+    for (size_t i = 0; i < L2_OUT; ++i)
+    {
+        auto acc = Zero(D32{});
+        for (size_t j = 0; j < L2_IN; j += Lanes(D32{}))
+        {
+            const auto w = PromoteTo(D32{}, Load(D16{}, &g_net.l2_weights[i * L2_IN + j]));
+            acc          = Add(acc, Mul(Load(D32{}, &in[j]), w));
+        }
+        sum += ReduceSum(D32{}, acc);
+    }
+    return sum;
+}
+
+int32_t l2_lanes(const int32_t* in)
+{
+    using D32              = CappedTag<int32_t, L2_OUT>;
+    constexpr size_t N_ACC = L2_OUT / Lanes(D32{});
+
+    std::array<Vec<D32>, N_ACC> acc;
+    for (auto& a : acc)
+        a = Zero(D32{});
+    for (size_t j = 0; j < L2_IN; ++j)
+    {
+        const auto     x = Set(D32{}, in[j]);
+        const int32_t* w = &g_net.l2->weights[j * L2_OUT];
+        for (size_t b = 0; b < N_ACC; ++b)
+            acc[b] = Add(acc[b], Mul(x, Load(D32{}, &w[b * Lanes(D32{})])));
+    }
+
+    HWY_ALIGN std::array<int32_t, L2_OUT> out;
+    for (size_t b = 0; b < N_ACC; ++b)
+        Store(acc[b], D32{}, &out[b * Lanes(D32{})]);
+    return out[0];
+}
+
+void bench_layouts(const size_t iterations, std::mt19937& rng, int32_t& sink)
+{
+    std::uniform_int_distribution<int> value(1, 127);
+    HWY_ALIGN std::array<int32_t, L2_IN> l1_out{};
+    for (auto& x : l1_out)
+        x = value(rng);
+
+    const double l2_r = time_eval(iterations, [&] { sink += l2_reduce(l1_out.data()); });
+    const double l2_l = time_eval(iterations, [&] { sink += l2_lanes(l1_out.data()); });
+
+    // the whole evaluation through the dispatched kernels against the scalar reference
+    Position pos;
+    pos.from_fen("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+    const Accumulator acc{pos};
+    const double      eval_s = time_eval(iterations / 16, [&] { sink += acc.evaluate_reference(WHITE); });
+    const double      eval_k = time_eval(iterations / 16, [&] { sink += acc.evaluate(WHITE); });
+
+    std::cout << "l2 int32\treduce " << l2_r << " ns\tlanes " << l2_l << " ns\tspeedup " << l2_r / l2_l << "\n";
+    std::cout << "evaluate\tscalar " << eval_s << " ns\tkernels " << eval_k << " ns\tspeedup " << eval_s / eval_k
+              << "\n";
+}
+
+} // namespace
+HWY_AFTER_NAMESPACE();
+
+int main(const int argc, char** argv)
+{
+    const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2'000'000;
+
+    std::mt19937 rng(42);
+    int16_t      sink = 0;
+
+    bench_shape<1, 1>("quiet (1 add, 1 sub)", iterations, rng, sink);
+    bench_shape<1, 2>("capture (1 add, 2 sub)", iterations, rng, sink);
+    bench_shape<2, 2>("castling (2 add, 2 sub)", iterations, rng, sink);
+
+    int32_t layer_sink = 0;
+    bench_layouts(iterations, rng, layer_sink);
+
+    // keeps the updates from being optimised away
+    std::cout << "target " << nnue_kernels::target_name() << " (layouts " << hwy::TargetName(HWY_TARGET) << ")\n";
+    std::cout << "checksum " << (sink ^ layer_sink) << "\n";
+    return 0;
+}
@@ -0,0 +1,63 @@
+//
+// Created by paul on 10/16/26.
+//
+
+// compiles the kernels of nnue_kernels-inl.h once per target and routes every call to the best one the cpu runs
+// the choice is made on the first call and kept
+// only targets at or above the -march of the build are generated: avx2 up to avx512 vnni for the default x86-64-v3,
+// sse4 and up for an x86-64-v2 build, neon and up on arm
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "ChePP/engine/nnue_kernels-inl.h"
+#include <hwy/foreach_target.h>
+
+#include "ChePP/engine/nnue_kernels-inl.h"
+
+#if HWY_ONCE
+
+namespace nnue_kernels
+{
+    HWY_EXPORT(add_sub_1_1);
+    HWY_EXPORT(add_sub_1_2);
+    HWY_EXPORT(add_sub_2_2);
+    HWY_EXPORT(add_sub);
+    HWY_EXPORT(evaluate);
+    HWY_EXPORT(evaluate_batch);
+    HWY_EXPORT(target);
+
+    void add_sub_1_1(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub)
+    {
+        HWY_DYNAMIC_DISPATCH(add_sub_1_1)(dst, src, add, sub);
+    }
+
+    void add_sub_1_2(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub)
+    {
+        HWY_DYNAMIC_DISPATCH(add_sub_1_2)(dst, src, add, sub);
+    }
+
+    void add_sub_2_2(int16_t* dst, const int16_t* src, const FeatureT* add, const FeatureT* sub)
+    {
+        HWY_DYNAMIC_DISPATCH(add_sub_2_2)(dst, src, add, sub);
+    }
+
+    void add_sub(int16_t* dst, const int16_t* src, const FeatureT* add, const size_t n_add, const FeatureT* sub,
+                 const size_t n_sub)
+    {
+        HWY_DYNAMIC_DISPATCH(add_sub)(dst, src, add, n_add, sub, n_sub);
+    }
+
+    int32_t evaluate(const int16_t* us, const int16_t* them, const size_t bucket)
+    {
+        return HWY_DYNAMIC_DISPATCH(evaluate)(us, them, bucket);
+    }
+
+    void evaluate_batch(const int16_t* const* us, const int16_t* const* them, const size_t n, const size_t bucket,
+                        int32_t* out)
+    {
+        HWY_DYNAMIC_DISPATCH(evaluate_batch)(us, them, n, bucket, out);
+    }
+
+    const char* target_name() { return hwy::TargetName(HWY_DYNAMIC_DISPATCH(target)()); }
+} // namespace nnue_kernels
+
+#endif // HWY_ONCE